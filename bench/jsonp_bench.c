@@ -0,0 +1,971 @@
+/*
+ *  jsonp_bench - benchmarks for the lexer and the code built on it.
+ *
+ *  build, from the top of the repository:
+ *      cc -O2 -o jsonp_bench bench/jsonp_bench.c -pthread
+ *
+ *  run:
+ *      ./jsonp_bench [-d dir] [-s megabytes] [-r repeats] [-f filter] > new.json
+ *      ./jsonp_bench -c old.json new.json
+ *
+ *  a corpus is generated into @dir (jsonp_corpus by default) from a
+ *  fixed seed, so that every build is measured on the same bytes; it
+ *  is only written when a file of the right size isn't there already.
+ *  every benchmark runs in a child process of its own, so its peak
+ *  rss is its own, and the results are written as json, which -c
+ *  compares between two runs.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <float.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <pthread.h>
+
+/* every allocation jsonp makes is counted, by routing its calls to
+   malloc and realloc through these */
+static size_t bench_allocations;
+
+static void *bench_malloc(size_t size)
+{
+        __atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+        return malloc(size);
+}
+
+static void *bench_realloc(void *ptr, size_t size)
+{
+        __atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+        return realloc(ptr, size);
+}
+
+static void *bench_calloc(size_t count, size_t size)
+{
+        __atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+        return calloc(count, size);
+}
+
+#define malloc(size) bench_malloc(size)
+#define realloc(ptr, size) bench_realloc(ptr, size)
+#define calloc(count, size) bench_calloc(count, size)
+#define JSONP_IMPLEMENTATION
+#include "../jsonp.h"
+#undef malloc
+#undef realloc
+#undef calloc
+
+#define BENCH_VERSION 1
+#define BENCH_SEED 0x6a736f6e70ULL
+#define BENCH_CHUNK_SIZE (64 * 1024)
+
+/* the measurements of one benchmark, the best of the runs is kept */
+struct bench_result {
+        double seconds;
+        size_t bytes;
+        size_t tokens;
+        size_t allocations;
+        long peak_rss_kb;
+        int status;
+};
+
+/* what a benchmark is given: the corpus file, and its contents read
+   into memory beforehand so that reading isn't timed */
+struct bench_input {
+        const char *path;
+        char *data;
+        size_t size;
+};
+
+typedef int (*bench_function)(const struct bench_input *input, struct bench_result *result);
+
+/* xorshift, so the corpus is the same on every platform */
+static uint64_t bench_state = BENCH_SEED;
+
+static uint64_t bench_random(void)
+{
+        bench_state ^= bench_state << 13;
+        bench_state ^= bench_state >> 7;
+        bench_state ^= bench_state << 17;
+        return bench_state;
+}
+
+static size_t bench_below(size_t n)
+{
+        return (size_t)(bench_random() % n);
+}
+
+static double bench_now(void)
+{
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/* corpus generation, each generator writes values until @size bytes
+   have been written, into @w */
+
+static void bench_random_string(jsonp_writer_t *w, size_t length)
+{
+        static const char *pieces[] = {
+                "a", "b", "c", "d", "e", "f", " ", "json", "lexer", "\"", "\\", "/",
+                "\n", "\t", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "0", "9",
+        };
+        char text[512];
+        size_t n = 0;
+
+        while (n < length && n + 4 < sizeof(text)) {
+                /* mostly plain text, as real strings are */
+                const char *piece = bench_below(8) ? pieces[bench_below(6)]
+                        : pieces[bench_below(sizeof(pieces) / sizeof(pieces[0]))];
+                size_t size = strlen(piece);
+                memcpy(text + n, piece, size);
+                n += size;
+        }
+        jsonp_string_n_writer(w, text, n);
+}
+
+static void bench_random_number(jsonp_writer_t *w)
+{
+        switch (bench_below(4)) {
+        case 0:
+                jsonp_int_writer(w, (int64_t)bench_below(1000) - 500);
+                break;
+        case 1:
+                jsonp_int_writer(w, (int64_t)(bench_random() >> 1) * (bench_below(2) ? 1 : -1));
+                break;
+        case 2:
+                jsonp_double_writer(w, (double)bench_below(100000) / 100.0);
+                break;
+        default:
+                jsonp_double_writer(w, (double)(bench_random() >> 11) / 9007199254740992.0
+                                    * 1e-5 * (double)(1 + bench_below(1000000000)));
+                break;
+        }
+}
+
+static void bench_random_record(jsonp_writer_t *w, size_t id)
+{
+        jsonp_begin_object_writer(w);
+        jsonp_key_writer(w, "id");
+        jsonp_uint_writer(w, id);
+        jsonp_key_writer(w, "name");
+        bench_random_string(w, 4 + bench_below(12));
+        jsonp_key_writer(w, "active");
+        jsonp_bool_writer(w, (int)bench_below(2));
+        jsonp_key_writer(w, "score");
+        bench_random_number(w);
+        jsonp_key_writer(w, "tags");
+        jsonp_begin_array_writer(w);
+        for (size_t i = bench_below(5); i > 0; i--)
+                bench_random_string(w, 2 + bench_below(8));
+        jsonp_end_array_writer(w);
+        jsonp_key_writer(w, "parent");
+        if (bench_below(3))
+                jsonp_null_writer(w);
+        else
+                jsonp_uint_writer(w, bench_below(id + 1));
+        jsonp_key_writer(w, "note");
+        bench_random_string(w, bench_below(64));
+        jsonp_end_object_writer(w);
+}
+
+static size_t bench_written(const jsonp_writer_t *w, size_t flushed)
+{
+        return flushed + (size_t)w->out.size;
+}
+
+struct bench_file {
+        FILE *fd;
+        size_t written;
+};
+
+static int bench_flush_file(void *user, const char *data, size_t size)
+{
+        struct bench_file *file = user;
+        file->written += size;
+        return fwrite(data, 1, size, file->fd) != size;
+}
+
+/* rows of numbers of every kind */
+static void bench_numbers(jsonp_writer_t *w, struct bench_file *file, size_t size)
+{
+        jsonp_begin_array_writer(w);
+        while (bench_written(w, file->written) < size) {
+                jsonp_begin_array_writer(w);
+                for (int i = 0; i < 16; i++)
+                        bench_random_number(w);
+                jsonp_end_array_writer(w);
+        }
+        jsonp_end_array_writer(w);
+}
+
+/* strings of all lengths, with escapes and multi-byte characters */
+static void bench_strings(jsonp_writer_t *w, struct bench_file *file, size_t size)
+{
+        jsonp_begin_array_writer(w);
+        while (bench_written(w, file->written) < size)
+                bench_random_string(w, bench_below(8) ? bench_below(32) : bench_below(480));
+        jsonp_end_array_writer(w);
+}
+
+/* values nested a few hundred levels deep */
+static void bench_nested(jsonp_writer_t *w, struct bench_file *file, size_t size)
+{
+        jsonp_begin_array_writer(w);
+        while (bench_written(w, file->written) < size) {
+                size_t depth = 64 + bench_below(448);
+                for (size_t i = 0; i < depth; i++) {
+                        if (i % 2) {
+                                jsonp_begin_array_writer(w);
+                                bench_random_number(w);
+                        } else {
+                                jsonp_begin_object_writer(w);
+                                jsonp_key_writer(w, "next");
+                        }
+                }
+                jsonp_null_writer(w);
+                for (size_t i = depth; i > 0; i--) {
+                        if ((i - 1) % 2)
+                                jsonp_end_array_writer(w);
+                        else
+                                jsonp_end_object_writer(w);
+                }
+        }
+        jsonp_end_array_writer(w);
+}
+
+/* objects with thousands of members each */
+static void bench_wide(jsonp_writer_t *w, struct bench_file *file, size_t size)
+{
+        char key[32];
+
+        jsonp_begin_array_writer(w);
+        while (bench_written(w, file->written) < size) {
+                jsonp_begin_object_writer(w);
+                for (int i = 0; i < 4096; i++) {
+                        snprintf(key, sizeof(key), "field_%d", i);
+                        jsonp_key_writer(w, key);
+                        if (i % 3)
+                                bench_random_number(w);
+                        else
+                                bench_random_string(w, bench_below(16));
+                }
+                jsonp_end_object_writer(w);
+        }
+        jsonp_end_array_writer(w);
+}
+
+/* one record per line */
+static void bench_lines(jsonp_writer_t *w, struct bench_file *file, size_t size)
+{
+        for (size_t id = 0; bench_written(w, file->written) < size; id++)
+                bench_random_record(w, id);
+}
+
+/* a single array of records, several times the size of the others */
+static void bench_large(jsonp_writer_t *w, struct bench_file *file, size_t size)
+{
+        jsonp_begin_array_writer(w);
+        for (size_t id = 0; bench_written(w, file->written) < size * 8; id++)
+                bench_random_record(w, id);
+        jsonp_end_array_writer(w);
+}
+
+struct bench_corpus {
+        const char *name;
+        const char *file;
+        void (*generate)(jsonp_writer_t *w, struct bench_file *file, size_t size);
+};
+
+static const struct bench_corpus bench_corpora[] = {
+        { "numbers", "numbers.json", bench_numbers },
+        { "strings", "strings.json", bench_strings },
+        { "nested", "nested.json", bench_nested },
+        { "wide", "wide.json", bench_wide },
+        { "lines", "lines.jsonl", bench_lines },
+        { "large", "large.json", bench_large },
+};
+
+#define BENCH_CORPUS_COUNT (sizeof(bench_corpora) / sizeof(bench_corpora[0]))
+
+/* write the corpus file @corpus into @path, unless it is there with
+   the size it was last generated with, which is kept alongside it */
+static int bench_generate(const struct bench_corpus *corpus, const char *path, size_t size)
+{
+        char stamp_path[4096 + 8], stamp[64], want[64];
+        struct bench_file file = { NULL, 0 };
+        jsonp_writer_t w;
+        FILE *fd;
+        int status;
+
+        snprintf(stamp_path, sizeof(stamp_path), "%s.size", path);
+        snprintf(want, sizeof(want), "%zu %d\n", size, BENCH_VERSION);
+        if ((fd = fopen(stamp_path, "r")) != NULL) {
+                size_t n = fread(stamp, 1, sizeof(stamp) - 1, fd);
+                fclose(fd);
+                stamp[n] = '\0';
+                if (strcmp(stamp, want) == 0 && access(path, R_OK) == 0)
+                        return 0;
+        }
+
+        /* each file has its own seed, so it doesn't depend on the others */
+        bench_state = BENCH_SEED + (uint64_t)(corpus - bench_corpora) * 0x9e3779b97f4a7c15ULL;
+        if ((file.fd = fopen(path, "wb")) == NULL) {
+                perror(path);
+                return -1;
+        }
+        jsonp_init_writer_flush(&w, 0, bench_flush_file, &file);
+        corpus->generate(&w, &file, size);
+        status = jsonp_free_writer(&w);
+        if (fclose(file.fd) != 0 || status != JSONP_NO_ERROR) {
+                fprintf(stderr, "%s: failed to write the corpus\n", path);
+                return -1;
+        }
+
+        if ((fd = fopen(stamp_path, "w")) != NULL) {
+                fputs(want, fd);
+                fclose(fd);
+        }
+        return 0;
+}
+
+/* the benchmarks, each runs over @input once and fills in @result */
+
+/* every token of the data, with the lexer made from @info */
+static int bench_lex(jsonp_info_t info, JSONP_TOKEN_MODE mode, struct bench_result *result)
+{
+        jsonp_lexer_t lexer;
+        jsonp_token tok;
+        int status;
+
+        if ((status = jsonp_lexer_init(&lexer, info)) != JSONP_NO_ERROR)
+                return status;
+        jsonp_lexer_set_token_mode(&lexer, mode);
+        while ((tok = jsonp_lexer_get_token(&lexer)).type != JSONP_TYPE_EOF) {
+                if (tok.type == JSONP_TYPE_ERROR) {
+                        status = JSONP_SYNTAX_ERROR;
+                        break;
+                }
+                result->tokens++;
+        }
+        jsonp_lexer_free(&lexer);
+        return status;
+}
+
+static int bench_tokens_file(const struct bench_input *input, struct bench_result *result)
+{
+        return bench_lex(jsonp_create_json_info(JSONP_FILE, input->path), JSONP_TOKEN_COPY, result);
+}
+
+static int bench_tokens_text(const struct bench_input *input, struct bench_result *result)
+{
+        return bench_lex(jsonp_create_json_info_n(JSONP_TEXT, input->data, input->size),
+                         JSONP_TOKEN_COPY, result);
+}
+
+static int bench_tokens_mmap(const struct bench_input *input, struct bench_result *result)
+{
+        return bench_lex(jsonp_create_json_info(JSONP_MMAP, input->path), JSONP_TOKEN_COPY, result);
+}
+
+static int bench_tokens_borrowed(const struct bench_input *input, struct bench_result *result)
+{
+        return bench_lex(jsonp_create_json_info_n(JSONP_TEXT_BORROWED, input->data, input->size),
+                         JSONP_TOKEN_COPY, result);
+}
+
+static int bench_tokens_view(const struct bench_input *input, struct bench_result *result)
+{
+        return bench_lex(jsonp_create_json_info_n(JSONP_TEXT_BORROWED, input->data, input->size),
+                         JSONP_TOKEN_VIEW, result);
+}
+
+/* the data fed to a JSONP_STREAM lexer a chunk at a time */
+static int bench_tokens_stream(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_lexer_t lexer;
+        jsonp_token tok;
+        size_t fed = 0;
+        int status;
+
+        if ((status = jsonp_lexer_init(&lexer, jsonp_create_json_info(JSONP_STREAM, NULL)))
+            != JSONP_NO_ERROR)
+                return status;
+        while ((tok = jsonp_lexer_get_token(&lexer)).type != JSONP_TYPE_EOF) {
+                if (tok.type == JSONP_TYPE_NEED_MORE) {
+                        size_t n = input->size - fed < BENCH_CHUNK_SIZE
+                                ? input->size - fed : BENCH_CHUNK_SIZE;
+                        if (n > 0)
+                                jsonp_feed(&lexer, input->data + fed, n);
+                        else
+                                jsonp_finish(&lexer);
+                        fed += n;
+                        continue;
+                }
+                if (tok.type == JSONP_TYPE_ERROR) {
+                        status = JSONP_SYNTAX_ERROR;
+                        break;
+                }
+                result->tokens++;
+        }
+        jsonp_lexer_free(&lexer);
+        return status;
+}
+
+static int bench_skip(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_lexer_t lexer;
+        int status;
+
+        (void)result;
+        if ((status = jsonp_lexer_init(&lexer, jsonp_create_json_info_n(JSONP_TEXT_BORROWED,
+                                                                        input->data, input->size)))
+            != JSONP_NO_ERROR)
+                return status;
+        while ((status = jsonp_skip_value(&lexer)) == JSONP_NO_ERROR
+               && jsonp_lexer_peek_token(&lexer).type != JSONP_TYPE_EOF)
+                ;
+        jsonp_lexer_free(&lexer);
+        return status;
+}
+
+static int bench_document(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_document_t doc;
+        int status;
+
+        (void)result;
+        status = jsonp_parse_document(&doc, jsonp_create_json_info_n(JSONP_TEXT_BORROWED,
+                                                                     input->data, input->size));
+        if (status == JSONP_NO_ERROR)
+                jsonp_free_document(&doc);
+        return status;
+}
+
+static int bench_document_stream(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_document_t doc;
+        jsonp_parser_t parser;
+        size_t fed = 0;
+        int status;
+
+        (void)result;
+        if ((status = jsonp_parser_init(&parser, &doc)) != JSONP_NO_ERROR)
+                return status;
+        while (fed < input->size) {
+                size_t n = input->size - fed < BENCH_CHUNK_SIZE
+                        ? input->size - fed : BENCH_CHUNK_SIZE;
+                status = jsonp_parser_feed(&parser, input->data + fed, n);
+                if (status != JSONP_NO_ERROR && status != JSONP_NEED_MORE_ERROR)
+                        break;
+                fed += n;
+        }
+        status = jsonp_parser_finish(&parser);
+        jsonp_parser_free(&parser);
+        jsonp_free_document(&doc);
+        return status;
+}
+
+/* the corpus file saved as a parsed document, beside it; it is saved
+   by bench_save_cache before the cases that read it are run, so that
+   none of their runs include saving it */
+static const char *bench_cache_path(const char *corpus)
+{
+        static char path[4096 + sizeof(".cache")];
+        snprintf(path, sizeof(path), "%s.cache", corpus);
+        return path;
+}
+
+static int bench_save_cache(const char *corpus)
+{
+        jsonp_document_t doc;
+        int status = jsonp_parse_document(&doc, jsonp_create_json_info(JSONP_MMAP, corpus));
+        if (status != JSONP_NO_ERROR)
+                return status;
+        status = jsonp_save_document(&doc, bench_cache_path(corpus));
+        jsonp_free_document(&doc);
+        return status;
+}
+
+static int bench_document_cache(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_document_t doc;
+        int status;
+
+        (void)result;
+        status = jsonp_parse_document(&doc, jsonp_create_json_info(JSONP_CACHE,
+                                                                   bench_cache_path(input->path)));
+        if (status == JSONP_NO_ERROR)
+                jsonp_free_document(&doc);
+        return status;
+}
+
+static int bench_tokens_cache(const struct bench_input *input, struct bench_result *result)
+{
+        return bench_lex(jsonp_create_json_info(JSONP_CACHE, bench_cache_path(input->path)),
+                         JSONP_TOKEN_VIEW, result);
+}
+
+static int bench_record(void *user, size_t record, const jsonp_document_t *doc, int status)
+{
+        (void)user;
+        (void)record;
+        (void)doc;
+        return status;
+}
+
+static int bench_lines_parse(const struct bench_input *input, struct bench_result *result)
+{
+        (void)result;
+        return jsonp_parse_lines(jsonp_create_json_info_n(JSONP_TEXT_BORROWED,
+                                                          input->data, input->size),
+                                 0, bench_record, NULL);
+}
+
+static int bench_elements(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_index_t index;
+        int status;
+
+        (void)result;
+        if ((status = jsonp_build_index(&index, jsonp_create_json_info_n(JSONP_TEXT_BORROWED,
+                                                                         input->data, input->size),
+                                        0)) != JSONP_NO_ERROR)
+                return status;
+        status = jsonp_parse_elements(&index, 0, bench_record, NULL);
+        jsonp_free_index(&index);
+        return status;
+}
+
+/* the records of the json lines, but for their tags, read into a
+   struct through a schema */
+struct bench_row {
+        uint64_t id;
+        jsonp_view_t name;
+        int active;
+        double score;
+        uint64_t parent;
+        jsonp_view_t note;
+};
+
+#define BENCH_ROW_FIELDS(X)                                     \
+        X(struct bench_row, id, JSONP_FIELD_UINT, NULL)         \
+        X(struct bench_row, name, JSONP_FIELD_STRING, NULL)     \
+        X(struct bench_row, active, JSONP_FIELD_BOOL, NULL)     \
+        X(struct bench_row, score, JSONP_FIELD_DOUBLE, NULL)    \
+        X(struct bench_row, parent, JSONP_FIELD_UINT, NULL)     \
+        X(struct bench_row, note, JSONP_FIELD_STRING, NULL)
+JSONP_SCHEMA(bench_row_schema, BENCH_ROW_FIELDS);
+
+static int bench_decode(const struct bench_input *input, struct bench_result *result)
+{
+        jsonp_lexer_t lexer;
+        struct bench_row row;
+        int status;
+
+        if ((status = jsonp_lexer_init(&lexer, jsonp_create_json_info_n(JSONP_TEXT_BORROWED,
+                                                                        input->data, input->size)))
+            != JSONP_NO_ERROR)
+                return status;
+        (void)result;
+        while ((status = jsonp_decode(&lexer, &bench_row_schema, &row)) == JSONP_NO_ERROR
+               && jsonp_lexer_peek_token(&lexer).type != JSONP_TYPE_EOF)
+                ;
+        jsonp_lexer_free(&lexer);
+        return status;
+}
+
+static int bench_discard(void *user, const char *data, size_t size)
+{
+        (void)user;
+        (void)data;
+        (void)size;
+        return 0;
+}
+
+static int bench_reformat(const struct bench_input *input, int indent)
+{
+        jsonp_writer_t w;
+        jsonp_init_writer_flush(&w, 0, bench_discard, NULL);
+        if (indent > 0)
+                jsonp_prettify(input->data, input->size, &w, indent);
+        else
+                jsonp_minify(input->data, input->size, &w);
+        return jsonp_free_writer(&w);
+}
+
+static int bench_minify(const struct bench_input *input, struct bench_result *result)
+{
+        (void)result;
+        return bench_reformat(input, 0);
+}
+
+static int bench_prettify(const struct bench_input *input, struct bench_result *result)
+{
+        (void)result;
+        return bench_reformat(input, 2);
+}
+
+/* the buffer routines on their own: a byte at a time, then in runs of
+   the sizes tokens come in, as much again as the input */
+static int bench_buffer(const struct bench_input *input, struct bench_result *result)
+{
+        buffer_t buffer;
+        size_t done = 0;
+        int status = JSONP_NO_ERROR;
+
+        (void)result;
+        if (jsonp_init_buffer(&buffer) != JSONP_NO_BUFFER_ERROR)
+                return JSONP_BUFFER_ERROR;
+        while (done < input->size / 2) {
+                jsonp_clear_buffer(&buffer);
+                for (int i = 0; i < 64 && done < input->size / 2; i++, done++)
+                        if (jsonp_append_buffer(&buffer, input->data[done]) != JSONP_NO_BUFFER_ERROR)
+                                status = JSONP_BUFFER_ERROR;
+        }
+        while (done < input->size) {
+                int n = (int)(1 + done % 47);
+                if ((size_t)n > input->size - done)
+                        n = (int)(input->size - done);
+                if (jsonp_write_n_buffer(&buffer, input->data + done, n) != JSONP_NO_BUFFER_ERROR)
+                        status = JSONP_BUFFER_ERROR;
+                done += n;
+        }
+        jsonp_free_buffer(&buffer);
+        return status;
+}
+
+/* @corpora lists the names of the corpora a benchmark runs on, or is
+   NULL for all but the json lines, which aren't a single document;
+   @cached is set for those that read the corpus's saved document */
+struct bench_case {
+        const char *name;
+        bench_function run;
+        const char *corpora;
+        int cached;
+};
+
+static const struct bench_case bench_cases[] = {
+        { "tokens_file", bench_tokens_file, NULL, 0 },
+        { "tokens_text", bench_tokens_text, NULL, 0 },
+        { "tokens_mmap", bench_tokens_mmap, NULL, 0 },
+        { "tokens_borrowed", bench_tokens_borrowed, NULL, 0 },
+        { "tokens_view", bench_tokens_view, NULL, 0 },
+        { "tokens_stream", bench_tokens_stream, NULL, 0 },
+        { "skip_value", bench_skip, NULL, 0 },
+        { "document", bench_document, NULL, 0 },
+        { "document_stream", bench_document_stream, NULL, 0 },
+        { "document_cache", bench_document_cache, NULL, 1 },
+        { "tokens_cache", bench_tokens_cache, NULL, 1 },
+        { "parse_lines", bench_lines_parse, " lines ", 0 },
+        { "parse_elements", bench_elements, " large ", 0 },
+        { "decode", bench_decode, " lines ", 0 },
+        { "minify", bench_minify, NULL, 0 },
+        { "prettify", bench_prettify, NULL, 0 },
+        { "buffer", bench_buffer, " strings ", 0 },
+};
+
+#define BENCH_CASE_COUNT (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+static int bench_applies(const struct bench_case *bc, const struct bench_corpus *corpus)
+{
+        char name[64];
+        if (bc->corpora == NULL)
+                return strcmp(corpus->name, "lines") != 0;
+        snprintf(name, sizeof(name), " %s ", corpus->name);
+        return strstr(bc->corpora, name) != NULL;
+}
+
+static int bench_read_file(const char *path, struct bench_input *input)
+{
+        FILE *fd = fopen(path, "rb");
+        long size;
+
+        if (fd == NULL || fseek(fd, 0, SEEK_END) != 0 || (size = ftell(fd)) < 0) {
+                if (fd)
+                        fclose(fd);
+                return -1;
+        }
+        rewind(fd);
+        input->path = path;
+        input->size = (size_t)size;
+        if ((input->data = malloc(input->size + 1)) == NULL
+            || fread(input->data, 1, input->size, fd) != input->size) {
+                fclose(fd);
+                return -1;
+        }
+        input->data[input->size] = '\0';
+        fclose(fd);
+        return 0;
+}
+
+/* run @bc over @path @repeats times, keeping the fastest; this is
+   done in the child of a fork, which sends @result back over @pipe */
+static void bench_child(const struct bench_case *bc, const char *path, int repeats, int pipe)
+{
+        struct bench_result result, best;
+        struct bench_input input;
+        struct rusage usage;
+
+        memset(&best, 0, sizeof(best));
+        if (bench_read_file(path, &input) != 0) {
+                best.status = JSONP_FILE_ERROR;
+                goto done;
+        }
+        best.bytes = input.size;
+        best.seconds = -1;
+        for (int i = 0; i < repeats; i++) {
+                memset(&result, 0, sizeof(result));
+                bench_allocations = 0;
+                double start = bench_now();
+                result.status = bc->run(&input, &result);
+                result.seconds = bench_now() - start;
+                result.allocations = bench_allocations;
+                if (result.status != JSONP_NO_ERROR) {
+                        best.status = result.status;
+                        break;
+                }
+                if (best.seconds < 0 || result.seconds < best.seconds) {
+                        best.seconds = result.seconds;
+                        best.tokens = result.tokens;
+                        best.allocations = result.allocations;
+                }
+        }
+        free(input.data);
+
+done:
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+                best.peak_rss_kb = usage.ru_maxrss;
+        if (write(pipe, &best, sizeof(best)) != (ssize_t)sizeof(best))
+                _exit(1);
+        _exit(0);
+}
+
+static int bench_run(const struct bench_case *bc, const char *path, int repeats,
+                     struct bench_result *result)
+{
+        int fds[2], status;
+        pid_t pid;
+
+        fflush(NULL);
+        if (pipe(fds) != 0 || (pid = fork()) < 0) {
+                perror("fork");
+                return -1;
+        }
+        if (pid == 0) {
+                close(fds[0]);
+                bench_child(bc, path, repeats, fds[1]);
+        }
+        close(fds[1]);
+        status = read(fds[0], result, sizeof(*result)) == (ssize_t)sizeof(*result) ? 0 : -1;
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        return status;
+}
+
+static void bench_write_result(jsonp_writer_t *w, const char *corpus, const char *name,
+                               const struct bench_result *result)
+{
+        double megabytes = (double)result->bytes / (1024.0 * 1024.0);
+
+        jsonp_begin_object_writer(w);
+        jsonp_key_writer(w, "corpus");
+        jsonp_string_writer(w, corpus);
+        jsonp_key_writer(w, "case");
+        jsonp_string_writer(w, name);
+        jsonp_key_writer(w, "status");
+        jsonp_int_writer(w, result->status);
+        jsonp_key_writer(w, "bytes");
+        jsonp_uint_writer(w, result->bytes);
+        if (result->status == JSONP_NO_ERROR && result->seconds > 0) {
+                jsonp_key_writer(w, "seconds");
+                jsonp_double_writer(w, result->seconds);
+                jsonp_key_writer(w, "mb_per_s");
+                jsonp_double_writer(w, (double)(int64_t)(megabytes / result->seconds * 10) / 10);
+                if (result->tokens > 0) {
+                        jsonp_key_writer(w, "tokens");
+                        jsonp_uint_writer(w, result->tokens);
+                        jsonp_key_writer(w, "tokens_per_s");
+                        jsonp_uint_writer(w, (uint64_t)((double)result->tokens / result->seconds));
+                }
+                jsonp_key_writer(w, "allocations");
+                jsonp_uint_writer(w, result->allocations);
+                jsonp_key_writer(w, "allocations_per_mb");
+                jsonp_double_writer(w, (double)(int64_t)((double)result->allocations
+                                                         / megabytes * 100) / 100);
+        }
+        jsonp_key_writer(w, "peak_rss_kb");
+        jsonp_int_writer(w, result->peak_rss_kb);
+        jsonp_end_object_writer(w);
+}
+
+/* find the result for @corpus and @name among @results */
+static jsonp_value_t bench_find(jsonp_value_t results, jsonp_view_t corpus, jsonp_view_t name)
+{
+        for (jsonp_value_t r = jsonp_first_value(results); jsonp_get_type_value(r);
+             r = jsonp_next_value(r)) {
+                jsonp_view_t c = jsonp_get_string_value(jsonp_get_field_value(r, "corpus"));
+                jsonp_view_t n = jsonp_get_string_value(jsonp_get_field_value(r, "case"));
+                if (c.size == corpus.size && memcmp(c.data, corpus.data, c.size) == 0
+                    && n.size == name.size && memcmp(n.data, name.data, n.size) == 0)
+                        return r;
+        }
+        return jsonp_invalid_value();
+}
+
+/* print the change in throughput and allocations of each benchmark
+   in @old_path that is also in @new_path */
+static int bench_compare(const char *old_path, const char *new_path)
+{
+        jsonp_document_t old_doc, new_doc;
+
+        if (jsonp_parse_document(&old_doc, jsonp_create_json_info(JSONP_MMAP, old_path))
+            != JSONP_NO_ERROR) {
+                fprintf(stderr, "%s: %s\n", old_path, jsonp_get_error());
+                return 1;
+        }
+        if (jsonp_parse_document(&new_doc, jsonp_create_json_info(JSONP_MMAP, new_path))
+            != JSONP_NO_ERROR) {
+                fprintf(stderr, "%s: %s\n", new_path, jsonp_get_error());
+                jsonp_free_document(&old_doc);
+                return 1;
+        }
+
+        jsonp_value_t old_results = jsonp_get_field_value(jsonp_get_root_document(&old_doc), "results");
+        jsonp_value_t new_results = jsonp_get_field_value(jsonp_get_root_document(&new_doc), "results");
+        printf("%-10s %-16s %10s %10s %8s %12s %12s\n", "corpus", "case",
+               "old MB/s", "new MB/s", "change", "old allocs", "new allocs");
+        for (jsonp_value_t r = jsonp_first_value(new_results); jsonp_get_type_value(r);
+             r = jsonp_next_value(r)) {
+                jsonp_view_t corpus = jsonp_get_string_value(jsonp_get_field_value(r, "corpus"));
+                jsonp_view_t name = jsonp_get_string_value(jsonp_get_field_value(r, "case"));
+                jsonp_value_t o = bench_find(old_results, corpus, name);
+                if (!jsonp_get_type_value(o))
+                        continue;
+
+                double old_speed = jsonp_get_double_value(jsonp_get_field_value(o, "mb_per_s"));
+                double new_speed = jsonp_get_double_value(jsonp_get_field_value(r, "mb_per_s"));
+                printf("%-10.*s %-16.*s %10.1f %10.1f %+7.1f%% %12lld %12lld\n",
+                       (int)corpus.size, corpus.data, (int)name.size, name.data,
+                       old_speed, new_speed,
+                       old_speed > 0 ? (new_speed / old_speed - 1) * 100 : 0.0,
+                       (long long)jsonp_get_int_value(jsonp_get_field_value(o, "allocations")),
+                       (long long)jsonp_get_int_value(jsonp_get_field_value(r, "allocations")));
+        }
+
+        jsonp_free_document(&old_doc);
+        jsonp_free_document(&new_doc);
+        return 0;
+}
+
+static void bench_usage(const char *program)
+{
+        fprintf(stderr,
+                "usage: %s [-d dir] [-s megabytes] [-r repeats] [-f filter]\n"
+                "       %s -c old.json new.json\n"
+                "  -d  directory the corpus is kept in, jsonp_corpus by default\n"
+                "  -s  size of each corpus file in megabytes, 16 by default,\n"
+                "      the large file is eight times that\n"
+                "  -r  runs of each benchmark, the fastest is reported, 3 by default\n"
+                "  -f  only run the benchmarks whose corpus/case contains filter\n"
+                "  -c  compare the results of two runs\n",
+                program, program);
+}
+
+int main(int argc, char **argv)
+{
+        const char *dir = "jsonp_corpus", *filter = NULL;
+        size_t megabytes = 16;
+        int repeats = 3, opt;
+        jsonp_writer_t w;
+
+        while ((opt = getopt(argc, argv, "d:s:r:f:c:h")) != -1) {
+                switch (opt) {
+                case 'd':
+                        dir = optarg;
+                        break;
+                case 's':
+                        megabytes = (size_t)strtoul(optarg, NULL, 10);
+                        break;
+                case 'r':
+                        repeats = atoi(optarg);
+                        break;
+                case 'f':
+                        filter = optarg;
+                        break;
+                case 'c':
+                        if (optind >= argc) {
+                                bench_usage(argv[0]);
+                                return 2;
+                        }
+                        return bench_compare(optarg, argv[optind]);
+                default:
+                        bench_usage(argv[0]);
+                        return 2;
+                }
+        }
+        if (megabytes == 0 || repeats <= 0) {
+                bench_usage(argv[0]);
+                return 2;
+        }
+
+        mkdir(dir, 0755);
+        for (size_t i = 0; i < BENCH_CORPUS_COUNT; i++) {
+                char path[4096];
+                snprintf(path, sizeof(path), "%s/%s", dir, bench_corpora[i].file);
+                fprintf(stderr, "corpus %s\n", path);
+                if (bench_generate(&bench_corpora[i], path, megabytes * 1024 * 1024) != 0)
+                        return 1;
+        }
+
+        jsonp_init_writer_file(&w, 2, stdout);
+        jsonp_begin_object_writer(&w);
+        jsonp_key_writer(&w, "version");
+        jsonp_int_writer(&w, BENCH_VERSION);
+        jsonp_key_writer(&w, "corpus_mb");
+        jsonp_uint_writer(&w, megabytes);
+        jsonp_key_writer(&w, "repeats");
+        jsonp_int_writer(&w, repeats);
+        jsonp_key_writer(&w, "results");
+        jsonp_begin_array_writer(&w);
+
+        for (size_t i = 0; i < BENCH_CORPUS_COUNT; i++) {
+                int cached = 0;
+                for (size_t j = 0; j < BENCH_CASE_COUNT; j++) {
+                        const struct bench_case *bc = &bench_cases[j];
+                        struct bench_result result;
+                        char path[4096], name[128];
+
+                        snprintf(name, sizeof(name), "%s/%s", bench_corpora[i].name, bc->name);
+                        if (!bench_applies(bc, &bench_corpora[i])
+                            || (filter != NULL && strstr(name, filter) == NULL))
+                                continue;
+                        snprintf(path, sizeof(path), "%s/%s", dir, bench_corpora[i].file);
+                        fprintf(stderr, "%s\n", name);
+                        /* saved afresh, in case the corpus has changed */
+                        if (bc->cached && !cached) {
+                                if (bench_save_cache(path) != JSONP_NO_ERROR)
+                                        fprintf(stderr, "can't save %s\n", bench_cache_path(path));
+                                cached = 1;
+                        }
+                        if (bench_run(bc, path, repeats, &result) != 0)
+                                continue;
+                        bench_write_result(&w, bench_corpora[i].name, bc->name, &result);
+                        jsonp_flush_writer(&w);
+                }
+        }
+
+        jsonp_end_array_writer(&w);
+        jsonp_end_object_writer(&w);
+        jsonp_free_writer(&w);
+        putchar('\n');
+        return 0;
+}
@@ -12,21 +12,54 @@
 
 #define JSONP_VERSION 1
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* stretchy buffer */
+/* allocator callbacks used for the lexer's memory:
+             @alloc returns @size bytes, or NULL
+             @resize moves @ptr, of @old_size bytes, to @new_size bytes
+             @release gives back @ptr, of @size bytes
+             @user is passed to each of the above
+*/
+typedef struct jsonp_allocator {
+        void *(* alloc)(void *user, size_t size);
+        void *(* resize)(void *user, void *ptr, size_t old_size, size_t new_size);
+        void (* release)(void *user, void *ptr, size_t size);
+        void *user;
+} jsonp_allocator_t;
+
+/* bump allocator, memory is carved out of large blocks and handed
+   back all at once by jsonp_arena_reset, which keeps the blocks for
+   reuse; @allocator hands out memory from the arena itself, and
+   @backing is where the blocks come from, or NULL for malloc */
+#define JSONP_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct jsonp_arena {
+        jsonp_allocator_t allocator;
+        const jsonp_allocator_t *backing;
+        struct jsonp_arena_block *head;
+        struct jsonp_arena_block *current;
+        size_t offset;
+        size_t block_size;
+        void *last;
+} jsonp_arena_t;
+
+/* stretchy buffer, memory comes from @allocator, or from malloc
+   when it is NULL */
 #define JSONP_BUFFER_CAPACITY 256
 
 typedef struct {
         char *data;
         int size;
         int capacity;
+        const jsonp_allocator_t *allocator;
 } buffer_t;
 
 /* json token types */
@@ -43,6 +76,10 @@ typedef enum {
         JSONP_TYPE_STRING,
         JSONP_TYPE_UNDEFINED,
         JSONP_TYPE_ERROR,
+        JSONP_TYPE_NEED_MORE,
+        JSONP_TYPE_TRUE,
+        JSONP_TYPE_FALSE,
+        JSONP_TYPE_NULL,
         JSONP_TYPE_COUNT,
 } JSONP_TYPE;
 
@@ -51,13 +88,86 @@ typedef enum {
         JSONP_NO_ERROR = 0,
         JSONP_FILE_ERROR,
         JSONP_BUFFER_ERROR,
+        JSONP_SYNTAX_ERROR,
+        JSONP_NOT_FOUND_ERROR,
+        JSONP_NEED_MORE_ERROR,
         JSONP_ERROR_COUNT,
 } JSONP_ERROR;
 
-/* structure storing token information */
+#define JSONP_ERROR_MESSAGE_CAPACITY 64
+#define JSONP_ERROR_SNIPPET_CAPACITY 32
+#define JSONP_NO_OFFSET ((size_t)-1)
+
+/* an error, as it was recorded, held inline so that recording one
+   never allocates:
+             @code stores the JSONP_ERROR it was reported as
+             @message stores a description, truncated if need be
+             @offset stores the byte at fault, counted from the start of
+                     the input, or JSONP_NO_OFFSET when the error isn't
+                     about a place in the input
+             @line stores the line of @offset, from 1, and @column the
+                   byte within that line, from 1; both are 0 when they
+                   can't be known, as for a stream whose start has
+                   already been dropped
+             @snippet stores the input around @offset, with control
+                      characters blanked out so that it prints on one
+                      line, and @snippet_pos where @offset falls in it
+*/
+typedef struct {
+        int code;
+        char message[JSONP_ERROR_MESSAGE_CAPACITY];
+        size_t offset;
+        size_t line;
+        size_t column;
+        char snippet[JSONP_ERROR_SNIPPET_CAPACITY];
+        int snippet_pos;
+} jsonp_error_t;
+
+/* a non-owning slice of text, @data is not necessarily
+   null-terminated */
+typedef struct {
+        const char *data;
+        size_t size;
+} jsonp_view_t;
+
+/* how the lexer hands back the text of each token:
+             JSONP_TOKEN_COPY - the text is copied into @token, a buffer
+                                owned by the lexer and reused for every token
+             JSONP_TOKEN_VIEW - only @view is set, pointing into the input
+                                or at a static literal; nothing is copied
+*/
+typedef enum {
+        JSONP_TOKEN_COPY = 0,
+        JSONP_TOKEN_VIEW,
+        JSONP_TOKEN_MODE_COUNT
+} JSONP_TOKEN_MODE;
+
+/* how the value of a number token was decoded */
+typedef enum {
+        JSONP_NUMBER_INT = 0,   /* an integer that fits in an int64_t */
+        JSONP_NUMBER_UINT,      /* a positive integer that only fits in a uint64_t */
+        JSONP_NUMBER_DOUBLE,    /* has a fraction or exponent, or is too large for either */
+        JSONP_NUMBER_TYPE_COUNT
+} JSONP_NUMBER_TYPE;
+
+/* the value of a number token, decoded while it was lexed; @i is set
+   for JSONP_NUMBER_INT, @u for JSONP_NUMBER_UINT and non-negative
+   JSONP_NUMBER_INT, and @d always holds the nearest double */
+typedef struct {
+        JSONP_NUMBER_TYPE type;
+        int64_t i;
+        uint64_t u;
+        double d;
+} jsonp_number_t;
+
+/* structure storing token information; the text in @token and
+   @view is only valid until the next token is read from the lexer,
+   use jsonp_materialize_token to keep hold of it */
 typedef struct {
         buffer_t token;
+        jsonp_view_t view;
         JSONP_TYPE type;
+        jsonp_number_t number;
 } jsonp_token;
 
 /* json info type enums used to describe the data
@@ -65,6 +175,11 @@ typedef struct {
 typedef enum {
         JSONP_FILE = 0,
         JSONP_TEXT,
+        JSONP_MMAP,
+        JSONP_TEXT_BORROWED,
+        JSONP_STREAM,
+        JSONP_TEXT_MUTABLE,
+        JSONP_CACHE,
         JSONP_INFO_DATA_COUNT
 } JSONP_INFO_DATA_TYPE;
 
@@ -73,12 +188,350 @@ typedef enum {
    interpreted:
              JSONP_FILE - @data is a file path
              JSONP_TEXT - @data is the json data
+             JSONP_MMAP - @data is a file path, the file is mapped
+                          into memory and lexed in place
+             JSONP_TEXT_BORROWED - @data is the json data, which is lexed
+                                   in place rather than copied, so it must
+                                   outlive the lexer
+             JSONP_STREAM - @data is the first chunk of json data, or NULL,
+                            the rest is pushed using jsonp_feed
+             JSONP_TEXT_MUTABLE - @data is writable json data, which is
+                                  lexed in place like JSONP_TEXT_BORROWED,
+                                  and has strings with escapes decoded
+                                  over the top of it
+             JSONP_CACHE - @data is the path of a document saved with
+                           jsonp_save_document, whose tokens are handed
+                           back from it without being lexed again
+   @size is the length of the json data, it need not be null-terminated
+   unless @size is zero
 */
 typedef struct {
         JSONP_INFO_DATA_TYPE type;
         const char *data;
+        size_t size;
 } jsonp_info_t;
 
+/* a parsed json document, stored as a tape: one flat array of 64-bit
+   entries in document order, each with a tag in its top byte:
+             '{' and '[' open a container, the rest of the entry is the
+                 index just past its closing entry, so it can be
+                 skipped in one step
+             '}' and ']' close a container, the rest of the entry is the
+                 index of its opening entry
+             '"' is a string, the rest of the entry is its offset into
+                 @strings, where it is stored as a 64-bit length, the
+                 text and a null terminator
+             'l', 'u' and 'd' are an int64_t, a uint64_t and a double,
+                 whose bits are held in the entry that follows
+             't', 'f' and 'n' are true, false and null
+   object members are stored as a string entry for the key followed
+   by the value; all of the memory comes from @allocator, or from malloc
+   when it is NULL, except for a document loaded by jsonp_load_document,
+   whose @tape and @strings may be within @map, a read-only mapping of
+   @map_size bytes of the file it was saved to */
+typedef struct {
+        uint64_t *tape;
+        size_t tape_size;
+        size_t tape_capacity;
+        char *strings;
+        size_t strings_size;
+        size_t strings_capacity;
+        const jsonp_allocator_t *allocator;
+        void *map;
+        size_t map_size;
+} jsonp_document_t;
+
+/* the type of a value within a document */
+typedef enum {
+        JSONP_VALUE_INVALID = 0,
+        JSONP_VALUE_OBJECT,
+        JSONP_VALUE_ARRAY,
+        JSONP_VALUE_STRING,
+        JSONP_VALUE_NUMBER,
+        JSONP_VALUE_TRUE,
+        JSONP_VALUE_FALSE,
+        JSONP_VALUE_NULL,
+        JSONP_VALUE_TYPE_COUNT
+} JSONP_VALUE_TYPE;
+
+/* a value within a document, @index is the value's entry in the tape;
+   values that weren't found have a NULL @doc and JSONP_VALUE_INVALID
+   as their type */
+typedef struct {
+        const jsonp_document_t *doc;
+        size_t index;
+} jsonp_value_t;
+
+/* called for each record of a batch of json lines, in the order the
+   records appear; @record counts the records from zero, blank lines
+   aside, and @doc holds the record when @status is JSONP_NO_ERROR.
+   returning non-zero stops the batch */
+typedef int (* jsonp_record_callback)(void *user, size_t record,
+                                      const jsonp_document_t *doc, int status);
+
+/* counters kept for each lexer when JSONP_STATS is defined, they
+   are compiled out otherwise:
+             @bytes is the input the lexer has consumed
+             @tokens counts the tokens lexed, by type, tokens handed
+                     back off the token stack aren't counted again
+             @allocations counts the memory the lexer allocated
+             @buffer_resizes counts the times one of its buffers grew
+             @stack_pushes and @stack_pops count the tokens put on the
+                           token stack by un-getting or peeking, and
+                           taken back off it
+             @documents counts the documents parsed
+*/
+typedef struct {
+        uint64_t bytes;
+        uint64_t tokens[JSONP_TYPE_COUNT];
+        uint64_t allocations;
+        uint64_t buffer_resizes;
+        uint64_t stack_pushes;
+        uint64_t stack_pops;
+        uint64_t documents;
+} jsonp_stats_t;
+
+/* hooks called around every document parse when JSONP_STATS is
+   defined, by the thread doing the parse, so they have to be thread
+   safe for jsonp_parse_lines and jsonp_parse_elements:
+             @begin is called with the data about to be parsed
+             @end is called with the same data, the lexer's counters
+                  for the parse, and the status it finished with
+*/
+typedef struct {
+        void (* begin)(void *user, jsonp_info_t info);
+        void (* end)(void *user, jsonp_info_t info, const jsonp_stats_t *stats, int status);
+        void *user;
+} jsonp_hooks_t;
+
+/* number of un-got, or peeked, tokens there is room for at first,
+   the token stack grows as needed after that */
+#define JSONP_TOKEN_STACK_CAPACITY 16
+
+/* structure storing all of the state used by the lexer; every
+   jsonp_lexer_* function takes one explicitly, so separate lexers
+   can be used on separate threads without any locking:
+             @tok stores the current token
+             @lookahead stores the current character in the file or buffer
+             @fd stores the file being read
+             @buffer stores the lexer's copy of JSONP_TEXT data
+             @input stores the data being lexed when it is held in
+                    memory, either @buffer or @map
+             @input_size stores the size of @input
+             @input_pos stores the read position within @input
+             @map stores the mapping of a JSONP_MMAP file
+             @map_size stores the size of @map
+             @token_stack stores tokens that have been un-got or peeked,
+                          @token_stack_size of them, in room for
+                          @token_stack_capacity
+             @token_mode selects how token text is handed back
+             @scratch collects the text of tokens read from @fd
+             @capture_start stores where the current token starts in @input
+             @input_base stores how much of a stream has been dropped
+                         from the front of @input
+             @error_offset stores where in @input the last error or
+                           undefined token went wrong
+             @scanner stores the scanning routines used on @input, picked
+                      to suit the cpu when the lexer is initialised
+             @stream_open is set while a JSONP_STREAM lexer can still be fed
+             @in_place is set when strings can be decoded over @input
+             @rewritten is set once one has been written over @input, so
+                        it can't be lexed again
+             @arena supplies all of the lexer's memory, either @own_arena
+                    or one passed to jsonp_lexer_init_arena
+             @stats counts what the lexer does, with JSONP_STATS
+             @stats_allocator hands the lexer's memory on from @arena,
+                              counting it into @stats
+             @cache stores the document a JSONP_CACHE lexer's tokens are
+                    made from, @cache_pos being the next entry of its
+                    tape, @cache_stack the tape indices of the containers
+                    open, @cache_depth of them, in room for
+                    @cache_capacity, @cache_next a comma or colon owed
+                    before the next entry, and @cache_key set when that
+                    entry is a key
+*/
+typedef struct jsonp_lexer {
+        jsonp_token tok;
+        int lookahead;
+        FILE *fd;
+        buffer_t buffer;
+        const char *input;
+        size_t input_size;
+        size_t input_pos;
+        void *map;
+        size_t map_size;
+        JSONP_TOKEN_MODE token_mode;
+        buffer_t scratch;
+        size_t capture_start;
+        size_t input_base;
+        size_t error_offset;
+        const struct jsonp_scanner *scanner;
+        int stream_open;
+        int in_place;
+        int rewritten;
+        jsonp_arena_t *arena;
+        jsonp_arena_t own_arena;
+        int token_stack_size;
+        int token_stack_capacity;
+        jsonp_token *token_stack;
+#ifdef JSONP_STATS
+        jsonp_stats_t stats;
+        jsonp_allocator_t stats_allocator;
+#endif
+        jsonp_document_t cache;
+        size_t cache_pos;
+        size_t *cache_stack;
+        size_t cache_depth;
+        size_t cache_capacity;
+        JSONP_TYPE cache_next;
+        int cache_key;
+} jsonp_lexer_t;
+
+/* the top-level elements of a json array, found by jsonp_build_index
+   so that they can be parsed separately:
+             @elements holds the text of each element, within the input
+             @lexer holds the input the elements point into */
+typedef struct {
+        jsonp_view_t *elements;
+        size_t element_count;
+        jsonp_lexer_t lexer;
+} jsonp_index_t;
+
+/* a document being parsed a chunk at a time, for input that can't be
+   waited on, such as a non-blocking socket:
+             @lexer holds the JSONP_STREAM data fed so far
+             @doc stores the document being built
+             @stack, @depth and @capacity track the containers that
+                    are still open, by the tape indices of their
+                    opening entries
+             @resume stores where the parse stopped for want of data
+             @status stores the outcome of the last chunk */
+typedef struct {
+        jsonp_lexer_t lexer;
+        jsonp_document_t *doc;
+        size_t *stack;
+        size_t depth;
+        size_t capacity;
+        int resume;
+        int status;
+} jsonp_parser_t;
+
+/* called by a writer to hand over @size bytes of output, returns
+   non-zero if the output couldn't be written */
+typedef int (* jsonp_flush_callback)(void *user, const char *data, size_t size);
+
+/* once a writer's output grows past this, it is handed to the flush
+   callback, if there is one */
+#define JSONP_WRITER_FLUSH_SIZE (64 * 1024)
+
+/* structure storing the state of a json writer:
+             @out collects the output, which is all of it unless there
+                  is a @flush callback, in which case it is what hasn't
+                  been flushed yet
+             @indent is the number of spaces per level, or 0 for
+                     compact output
+             @depth is the number of containers open
+             @first is set until a value has been written in the
+                    innermost container
+             @after_key is set between a key and its value
+             @status is the first error met, once set every write fails */
+typedef struct {
+        buffer_t out;
+        jsonp_flush_callback flush;
+        void *user;
+        const struct jsonp_scanner *scanner;
+        int indent;
+        int depth;
+        int first;
+        int after_key;
+        int status;
+} jsonp_writer_t;
+
+/* a set of paths compiled into a trie, so a document can be matched
+   against all of them in one pass; each node is one step of a path,
+   @nodes[0] being the document itself:
+             @name and @size are the node's key within @names
+             @index is the node's array index, or -1 if it has none
+             @child and @sibling link the trie, -1 ends a list
+             @id is the id of the path ending here, or -1 */
+struct jsonp_path_node {
+        size_t name;
+        size_t size;
+        long index;
+        int child;
+        int sibling;
+        int id;
+};
+
+typedef struct {
+        struct jsonp_path_node *nodes;
+        int node_count;
+        int node_capacity;
+        int path_count;
+        buffer_t names;
+} jsonp_paths_t;
+
+/* called for each value that matches a path, with @lexer at the
+   value; the value can be read off @lexer, and is skipped if it
+   isn't, in which case values of longer paths inside it can still
+   match. a value whose tokens were only peeked at, or were read and
+   un-got, is unread. returning non-zero stops the match */
+typedef int (* jsonp_path_callback)(void *user, int id, jsonp_lexer_t *lexer);
+
+/* the c type a json value is decoded into by a schema:
+             JSONP_FIELD_INT - an int64_t, from an integer
+             JSONP_FIELD_UINT - a uint64_t, from a non-negative integer
+             JSONP_FIELD_DOUBLE - a double, from any number
+             JSONP_FIELD_BOOL - an int, from true or false
+             JSONP_FIELD_STRING - a jsonp_view_t, from a string
+             JSONP_FIELD_OBJECT - a struct, from an object, decoded by
+                                  a schema of its own
+*/
+typedef enum {
+        JSONP_FIELD_INT = 0,
+        JSONP_FIELD_UINT,
+        JSONP_FIELD_DOUBLE,
+        JSONP_FIELD_BOOL,
+        JSONP_FIELD_STRING,
+        JSONP_FIELD_OBJECT,
+        JSONP_FIELD_TYPE_COUNT
+} JSONP_FIELD_TYPE;
+
+/* a member of a struct that a json key is decoded into:
+             @name and @size are the key
+             @type is how the value is decoded
+             @offset is where the member is in the struct
+             @schema decodes a JSONP_FIELD_OBJECT member */
+typedef struct jsonp_field {
+        const char *name;
+        size_t size;
+        JSONP_FIELD_TYPE type;
+        size_t offset;
+        const struct jsonp_schema *schema;
+} jsonp_field_t;
+
+typedef struct jsonp_schema {
+        const jsonp_field_t *fields;
+        int field_count;
+} jsonp_schema_t;
+
+/* schemas are declared from an x-macro listing the members of a
+   struct, each as X(struct type, member, JSONP_FIELD_TYPE, schema),
+   where schema is that of a JSONP_FIELD_OBJECT member, and NULL for
+   the rest:
+       #define POINT_FIELDS(X)                                  \
+               X(struct point, x, JSONP_FIELD_DOUBLE, NULL)     \
+               X(struct point, y, JSONP_FIELD_DOUBLE, NULL)
+       JSONP_SCHEMA(point_schema, POINT_FIELDS);
+*/
+#define JSONP_SCHEMA_FIELD(type, member, field_type, schema) \
+        { #member, sizeof(#member) - 1, field_type, offsetof(type, member), schema },
+#define JSONP_SCHEMA(name, FIELDS)                                             \
+        static const jsonp_field_t name##_fields[] = { FIELDS(JSONP_SCHEMA_FIELD) }; \
+        static const jsonp_schema_t name = {                                   \
+                name##_fields, (int)(sizeof(name##_fields) / sizeof(*name##_fields)) \
+        }
+
 /* json buffer errors to describe the type of error that occurred within
    the operations on the buffer_t structure */
 typedef enum {
@@ -90,6 +543,9 @@ typedef enum {
 /* create a jsonp info structure */
 JSONP_EXTERN jsonp_info_t jsonp_create_json_info(JSONP_INFO_DATA_TYPE type,
                                                  const char *data);
+/* create a jsonp info structure for @size bytes of json data at @data */
+JSONP_EXTERN jsonp_info_t jsonp_create_json_info_n(JSONP_INFO_DATA_TYPE type,
+                                                   const char *data, size_t size);
 /* initialise the json parpser using the information stored in
    the jsonp_info_t structure */
 JSONP_EXTERN int jsonp_init(jsonp_info_t info);
@@ -99,6 +555,27 @@ JSONP_EXTERN int jsonp_init(jsonp_info_t info);
    the open file it has */
 JSONP_EXTERN int jsonp_free(void);
 
+/* reentrant versions of the above, operating on @lexer rather
+   than the global state; a lexer initialised with jsonp_lexer_init
+   must be released with jsonp_lexer_free */
+JSONP_EXTERN int jsonp_lexer_init(jsonp_lexer_t *lexer, jsonp_info_t info);
+JSONP_EXTERN int jsonp_lexer_free(jsonp_lexer_t *lexer);
+
+/* initialise @lexer with all of its memory taken from @arena, the
+   memory isn't given back by jsonp_lexer_free, but by resetting the
+   arena, so a single jsonp_arena_reset releases a whole document */
+JSONP_EXTERN int jsonp_lexer_init_arena(jsonp_lexer_t *lexer, jsonp_info_t info,
+                                        jsonp_arena_t *arena);
+
+/* push @size bytes of json data into a JSONP_STREAM lexer; data that
+   has already been lexed is dropped, so only the token being lexed
+   when the previous chunk ran out is carried over. until jsonp_finish
+   is called, a token cut off by the end of the data fed so far is
+   returned as JSONP_TYPE_NEED_MORE and lexed again from its start
+   once more data has been fed */
+JSONP_EXTERN int jsonp_feed(jsonp_lexer_t *lexer, const char *data, size_t size);
+JSONP_EXTERN int jsonp_finish(jsonp_lexer_t *lexer);
+
 /* operations on the buffer_t structure, returns zero on success,
    otherwise non-zero on error, errors can be queried using a call
    to 'jsonp_get_error()' */
@@ -108,11 +585,38 @@ JSONP_EXTERN int jsonp_append_buffer(buffer_t *buffer, char c);
 JSONP_EXTERN int jsonp_write_buffer(buffer_t *buffer, const char *data);
 JSONP_EXTERN int jsonp_insert_buffer(buffer_t *buffer, const char *data, int offset);
 JSONP_EXTERN int jsonp_resize_buffer(buffer_t *buffer);
+JSONP_EXTERN int jsonp_reserve_buffer(buffer_t *buffer, int capacity);
 JSONP_EXTERN int jsonp_free_buffer(buffer_t *buffer);
 
-/* operations on the jsonp_token structure */
+JSONP_EXTERN int jsonp_write_n_buffer(buffer_t *buffer, const char *data, int size);
+JSONP_EXTERN int jsonp_append_n_buffer(buffer_t *buffer, const char *data, int size);
+
+/* operations on the jsonp_arena_t structure, @backing may be NULL */
+JSONP_EXTERN int jsonp_arena_init(jsonp_arena_t *arena, const jsonp_allocator_t *backing);
+JSONP_EXTERN void *jsonp_arena_alloc(jsonp_arena_t *arena, size_t size);
+JSONP_EXTERN void jsonp_arena_reset(jsonp_arena_t *arena);
+JSONP_EXTERN void jsonp_arena_free(jsonp_arena_t *arena);
+
+/* operations on the jsonp_token structure; in JSONP_TOKEN_VIEW
+   mode the data of string and number tokens isn't null-terminated,
+   so use jsonp_get_size_token or jsonp_get_view_token alongside it */
 JSONP_EXTERN JSONP_TYPE jsonp_get_type_token(jsonp_token tok);
 JSONP_EXTERN const char *jsonp_get_data_token(jsonp_token tok);
+JSONP_EXTERN size_t jsonp_get_size_token(jsonp_token tok);
+JSONP_EXTERN jsonp_view_t jsonp_get_view_token(jsonp_token tok);
+
+/* decoded values of JSONP_TYPE_NUMBER tokens, without calling strtod
+   on the token's text */
+JSONP_EXTERN jsonp_number_t jsonp_get_number_token(jsonp_token tok);
+JSONP_EXTERN int jsonp_is_integer_token(jsonp_token tok);
+JSONP_EXTERN int64_t jsonp_get_int_token(jsonp_token tok);
+JSONP_EXTERN uint64_t jsonp_get_uint_token(jsonp_token tok);
+JSONP_EXTERN double jsonp_get_double_token(jsonp_token tok);
+
+/* copy the text of @tok into @out, initialising @out if it has no
+   storage yet, the copy is owned by the caller and must be released
+   with jsonp_free_buffer */
+JSONP_EXTERN int jsonp_materialize_token(jsonp_token tok, buffer_t *out);
 
 /* token operations */
 JSONP_EXTERN jsonp_token jsonp_peek_token();
@@ -120,9 +624,217 @@ JSONP_EXTERN jsonp_token jsonp_get_token();
 JSONP_EXTERN jsonp_token jsonp_unget_token(jsonp_token tok);
 JSONP_EXTERN int jsonp_rewind(void);
 
-/* error code operations */
+/* reentrant token operations */
+JSONP_EXTERN jsonp_token jsonp_lexer_peek_token(jsonp_lexer_t *lexer);
+JSONP_EXTERN jsonp_token jsonp_lexer_get_token(jsonp_lexer_t *lexer);
+JSONP_EXTERN jsonp_token jsonp_lexer_unget_token(jsonp_lexer_t *lexer,
+                                                 jsonp_token tok);
+JSONP_EXTERN int jsonp_lexer_rewind(jsonp_lexer_t *lexer);
+
+/* select how @lexer hands back token text, JSONP_TOKEN_COPY is used
+   unless this is called after jsonp_lexer_init */
+JSONP_EXTERN int jsonp_lexer_set_token_mode(jsonp_lexer_t *lexer,
+                                            JSONP_TOKEN_MODE mode);
+
+/* on-demand navigation, for reading a few values out of a large
+   document without lexing all of it. jsonp_skip_value steps over the
+   next value, objects and arrays are stepped over by counting brackets
+   over the raw input, without making tokens or decoding strings, so
+   their contents aren't checked. jsonp_find_field moves forward
+   through the members of the object the lexer is in, or is about to
+   enter, up to the member @key, leaving the lexer at its value; as
+   the lexer only moves forward, fields have to be looked for in the
+   order they appear, and the value of a field that was found must be
+   read or skipped before looking for the next one. both return:
+             JSONP_NO_ERROR - the value was skipped, or the field found
+             JSONP_NOT_FOUND_ERROR - the object ended first, the lexer
+                                     is left at its '}'
+             JSONP_SYNTAX_ERROR - the json isn't what was expected
+             JSONP_NEED_MORE_ERROR - a JSONP_STREAM lexer ran out of
+                                     data, the lexer is stepped back so
+                                     the call can be made again once it
+                                     has been fed
+   with tokens un-got or peeked, or for JSONP_FILE data, the value is
+   stepped over token by token instead, and can't be stepped back */
+JSONP_EXTERN int jsonp_skip_value(jsonp_lexer_t *lexer);
+JSONP_EXTERN int jsonp_find_field(jsonp_lexer_t *lexer, const char *key);
+JSONP_EXTERN int jsonp_find_field_n(jsonp_lexer_t *lexer, const char *key, size_t size);
+
+/* operations on the jsonp_paths_t structure; jsonp_add_path compiles
+   @path, either a json pointer such as "/users/0/name", or a dotted
+   path such as "users.0.name", and returns its id, or -1 if it can't
+   be added. ids count up from zero, adding a path twice gives the
+   same id. numeric steps match array elements as well as keys */
+JSONP_EXTERN int jsonp_init_paths(jsonp_paths_t *paths);
+JSONP_EXTERN int jsonp_add_path(jsonp_paths_t *paths, const char *path);
+JSONP_EXTERN int jsonp_free_paths(jsonp_paths_t *paths);
+
+/* read the next value from @lexer, calling @callback for every value
+   in it that one of @paths leads to. values that no path goes into
+   are skipped with jsonp_skip_value, so are never lexed. returns
+   what @callback returned if it stopped the match, otherwise a
+   JSONP_ERROR; a JSONP_STREAM lexer needs all of the value fed first */
+JSONP_EXTERN int jsonp_match_paths(jsonp_lexer_t *lexer, const jsonp_paths_t *paths,
+                                   jsonp_path_callback callback, void *user);
+
+/* read the next value from @lexer, an object, into the struct at @out
+   as @schema says. keys are read straight from the input when it is
+   held in memory, and matched by length and then a word at a time,
+   the member after the one last matched being tried first; members
+   with keys the schema doesn't have are skipped with jsonp_skip_value.
+   members missing from the object, and those that are null, are left
+   as they were. strings point into the input, or, when they had to be
+   decoded or the input doesn't stay put, at a copy in the lexer's
+   arena, so stay valid until the lexer is freed. a value of the wrong
+   type is a JSONP_SYNTAX_ERROR, after which @out may be partly filled;
+   a JSONP_STREAM lexer needs all of the object fed first */
+JSONP_EXTERN int jsonp_decode(jsonp_lexer_t *lexer, const jsonp_schema_t *schema, void *out);
+
+/* parse the json data described by @info into @doc, which must be
+   released with jsonp_free_document; returns JSONP_SYNTAX_ERROR when
+   the data isn't a single valid json value. the _arena variant draws
+   all of the memory for the parse and the document from @arena */
+JSONP_EXTERN int jsonp_parse_document(jsonp_document_t *doc, jsonp_info_t info);
+JSONP_EXTERN int jsonp_parse_document_arena(jsonp_document_t *doc, jsonp_info_t info,
+                                            jsonp_arena_t *arena);
+JSONP_EXTERN int jsonp_free_document(jsonp_document_t *doc);
+
+/* save @doc to @path as it is held in memory, numbers decoded and
+   strings unescaped, so that jsonp_load_document can map it straight
+   back in without parsing anything. the file is written beside @path
+   and renamed over it, so that readers never see half of one. it is
+   in the byte order of the machine that wrote it; one of another byte
+   order or version fails to load with JSONP_FILE_ERROR, and should be
+   saved again. a saved document is trusted as it is, it is a cache
+   rather than a way of exchanging json. loading one with
+   jsonp_parse_document, as JSONP_CACHE data, is the same as
+   jsonp_load_document */
+JSONP_EXTERN int jsonp_save_document(const jsonp_document_t *doc, const char *path);
+JSONP_EXTERN int jsonp_load_document(jsonp_document_t *doc, const char *path);
+
+/* incremental parsing into @doc, which must be released with
+   jsonp_free_document whether or not the parse succeeds. nothing
+   blocks: jsonp_parser_feed parses as far as the data fed so far goes,
+   a token cut off by the end of a chunk being lexed again from its
+   start, and returns:
+             JSONP_NEED_MORE_ERROR - the value isn't complete yet
+             JSONP_NO_ERROR - the value is complete, anything fed after
+                              it must only be whitespace
+             JSONP_SYNTAX_ERROR - the data isn't valid json, as it is
+                                  returned from then on
+   jsonp_parser_finish is called once there's no more data to come, and
+   returns JSONP_SYNTAX_ERROR for a value that was left incomplete */
+JSONP_EXTERN int jsonp_parser_init(jsonp_parser_t *parser, jsonp_document_t *doc);
+JSONP_EXTERN int jsonp_parser_feed(jsonp_parser_t *parser, const char *data, size_t size);
+JSONP_EXTERN int jsonp_parser_finish(jsonp_parser_t *parser);
+JSONP_EXTERN int jsonp_parser_free(jsonp_parser_t *parser);
+
+/* parse each line of the json lines data described by @info into a
+   document, on @threads threads, or one per core when @threads is 0,
+   handing the documents to @callback in order. a line break inside a
+   string doesn't end a record. returns what @callback returned if it
+   stopped the batch, otherwise a JSONP_ERROR; a record that isn't
+   valid json is reported to @callback, and doesn't stop the batch */
+JSONP_EXTERN int jsonp_parse_lines(jsonp_info_t info, int threads,
+                                   jsonp_record_callback callback, void *user);
+
+/* split the json array described by @info into its elements on
+   @threads threads, or one per core when @threads is 0, without
+   parsing them; data that isn't an array is a single element. the
+   index must be released with jsonp_free_index. jsonp_parse_elements
+   then parses the elements on @threads threads, handing them to
+   @callback in order, as jsonp_parse_lines does */
+JSONP_EXTERN int jsonp_build_index(jsonp_index_t *index, jsonp_info_t info, int threads);
+JSONP_EXTERN int jsonp_free_index(jsonp_index_t *index);
+JSONP_EXTERN int jsonp_parse_elements(const jsonp_index_t *index, int threads,
+                                      jsonp_record_callback callback, void *user);
+
+/* initialise @writer to write json into its @out buffer, spaced with
+   @indent spaces per level, or compactly when @indent is 0; the _flush
+   variant hands the output to @flush whenever JSONP_WRITER_FLUSH_SIZE
+   bytes have built up, and the _file variant writes it to @fd */
+JSONP_EXTERN int jsonp_init_writer(jsonp_writer_t *writer, int indent);
+JSONP_EXTERN int jsonp_init_writer_flush(jsonp_writer_t *writer, int indent,
+                                         jsonp_flush_callback flush, void *user);
+JSONP_EXTERN int jsonp_init_writer_file(jsonp_writer_t *writer, int indent, FILE *fd);
+JSONP_EXTERN int jsonp_flush_writer(jsonp_writer_t *writer);
+JSONP_EXTERN int jsonp_free_writer(jsonp_writer_t *writer);
+
+/* write operations, the separators and spacing between values are
+   written as needed; each returns the writer's status. strings are
+   escaped as they are written, and doubles are written with the
+   fewest digits that read back as the same double, non-finite ones
+   being written as null */
+JSONP_EXTERN int jsonp_begin_object_writer(jsonp_writer_t *writer);
+JSONP_EXTERN int jsonp_end_object_writer(jsonp_writer_t *writer);
+JSONP_EXTERN int jsonp_begin_array_writer(jsonp_writer_t *writer);
+JSONP_EXTERN int jsonp_end_array_writer(jsonp_writer_t *writer);
+JSONP_EXTERN int jsonp_key_writer(jsonp_writer_t *writer, const char *key);
+JSONP_EXTERN int jsonp_key_n_writer(jsonp_writer_t *writer, const char *key, size_t size);
+JSONP_EXTERN int jsonp_string_writer(jsonp_writer_t *writer, const char *data);
+JSONP_EXTERN int jsonp_string_n_writer(jsonp_writer_t *writer, const char *data, size_t size);
+JSONP_EXTERN int jsonp_int_writer(jsonp_writer_t *writer, int64_t value);
+JSONP_EXTERN int jsonp_uint_writer(jsonp_writer_t *writer, uint64_t value);
+JSONP_EXTERN int jsonp_double_writer(jsonp_writer_t *writer, double value);
+JSONP_EXTERN int jsonp_bool_writer(jsonp_writer_t *writer, int value);
+JSONP_EXTERN int jsonp_null_writer(jsonp_writer_t *writer);
+
+/* write the json in @size bytes of @data to @writer without any
+   whitespace, or spaced with @indent spaces per level; the data is
+   checked as it goes, and strings and numbers are copied as they are,
+   escapes and all. the data can hold several values, which are
+   written as values of the writer would be. jsonp_reformat does the
+   same for the data of @info, mapping it when it is a file, and
+   minifies when @indent is 0 */
+JSONP_EXTERN int jsonp_minify(const char *data, size_t size, jsonp_writer_t *writer);
+JSONP_EXTERN int jsonp_prettify(const char *data, size_t size, jsonp_writer_t *writer, int indent);
+JSONP_EXTERN int jsonp_reformat(jsonp_info_t info, jsonp_writer_t *writer, int indent);
+
+/* operations on the values of a document; values of the wrong type
+   give an invalid value, an empty view or zero */
+JSONP_EXTERN jsonp_value_t jsonp_get_root_document(const jsonp_document_t *doc);
+JSONP_EXTERN JSONP_VALUE_TYPE jsonp_get_type_value(jsonp_value_t value);
+JSONP_EXTERN jsonp_view_t jsonp_get_string_value(jsonp_value_t value);
+JSONP_EXTERN jsonp_number_t jsonp_get_number_value(jsonp_value_t value);
+JSONP_EXTERN int64_t jsonp_get_int_value(jsonp_value_t value);
+JSONP_EXTERN double jsonp_get_double_value(jsonp_value_t value);
+
+/* look up the member @key of an object, or element @index of an
+   array; finding a member or element means stepping over the ones
+   before it, which is O(1) per member whatever its size */
+JSONP_EXTERN jsonp_value_t jsonp_get_field_value(jsonp_value_t object, const char *key);
+JSONP_EXTERN jsonp_value_t jsonp_get_field_n_value(jsonp_value_t object,
+                                                   const char *key, size_t size);
+JSONP_EXTERN jsonp_value_t jsonp_get_index_value(jsonp_value_t array, size_t index);
+JSONP_EXTERN size_t jsonp_get_size_value(jsonp_value_t value);
+
+/* iterate over the elements of an array, or the members of an object;
+   for objects each step lands on a member's key, and the member's
+   value is the key's jsonp_next_value. the end is an invalid value:
+       for (v = jsonp_first_value(array); jsonp_get_type_value(v); v = jsonp_next_value(v))
+*/
+JSONP_EXTERN jsonp_value_t jsonp_first_value(jsonp_value_t container);
+JSONP_EXTERN jsonp_value_t jsonp_next_value(jsonp_value_t value);
+
+/* error code operations; errors are kept per thread, the latest
+   first. jsonp_get_error pops the latest error's message, and
+   jsonp_get_error_record pops the whole of it into @error, returning
+   JSONP_NOT_FOUND_ERROR when there are none */
 JSONP_EXTERN int jsonp_had_error(void);
 JSONP_EXTERN const char *jsonp_get_error(void);
+JSONP_EXTERN int jsonp_get_error_record(jsonp_error_t *error);
+
+/* instrumentation, only kept when JSONP_STATS is defined, which, as it
+   changes jsonp_lexer_t, has to be done wherever this header is
+   included. jsonp_lexer_get_stats copies out the
+   counters of @lexer so far, jsonp_get_thread_stats the totals of the
+   lexers freed by the calling thread, both return
+   JSONP_NOT_FOUND_ERROR and zeroes when counting is compiled out.
+   jsonp_set_hooks installs @hooks for every document parse, or
+   removes them when @hooks is NULL */
+JSONP_EXTERN int jsonp_lexer_get_stats(const jsonp_lexer_t *lexer, jsonp_stats_t *stats);
+JSONP_EXTERN int jsonp_get_thread_stats(jsonp_stats_t *stats);
+JSONP_EXTERN void jsonp_set_hooks(const jsonp_hooks_t *hooks);
 
 
 #ifdef __cplusplus
@@ -134,122 +846,345 @@ JSONP_EXTERN const char *jsonp_get_error(void);
 /* removed when debugging is being removed */
 #define JSONP_DEBUG
 
-#ifdef JSONP_DEBUG
+#include <float.h>
+#include <limits.h>
+#include <locale.h>
 
-#define JSONP_TOKEN_STACK_CAPACITY 10
+#if defined(__unix__) || defined(__APPLE__)
+#define JSONP_HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
-/* @tok stores the current token
-   @lookahead stores the current character in the file or buffer
-   @curr_fd stores the file being read
-*/
-JSONP_STATIC jsonp_token tok;
-JSONP_STATIC int lookahead;
-JSONP_STATIC FILE *curr_fd;
-JSONP_STATIC buffer_t curr_buffer;
-JSONP_STATIC int curr_buffer_ptr;
-JSONP_STATIC int (* next_char)(void);
-
-/* used in order to un-get tokens, and peek tokens */
-JSONP_STATIC int jsonp_token_stack_size = 0;
-JSONP_STATIC int jsonp_token_stack_ptr = 0;
-JSONP_STATIC jsonp_token jsonp_token_stack[JSONP_TOKEN_STACK_CAPACITY];
-
-JSONP_STATIC int jsonp_push_token_stack(jsonp_token tok);
-JSONP_STATIC jsonp_token jsonp_pop_token_stack(void);
-JSONP_STATIC int jsonp_empty_token_stack(void);
-JSONP_STATIC int jsonp_full_token_stack(void);
+/* define JSONP_NO_THREADS to parse batches on the calling thread only */
+#if !defined(JSONP_NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define JSONP_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+/* define JSONP_NO_SIMD to only use the portable scanners */
+#if !defined(JSONP_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__))
+#define JSONP_HAVE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define JSONP_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+JSONP_STATIC int jsonp_ctz32(unsigned x)
+{
+        unsigned long index;
+        _BitScanForward(&index, x);
+        return (int)index;
+}
+#else
+#define jsonp_ctz32(x) __builtin_ctz(x)
+#endif
+
+/* storage class for state that must not be shared between threads */
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define JSONP_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define JSONP_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define JSONP_THREAD_LOCAL __declspec(thread)
+#else
+#define JSONP_THREAD_LOCAL __thread
+#endif
+
+/* a statement that is only compiled in with JSONP_STATS */
+#ifdef JSONP_STATS
+#define JSONP_STAT(statement) do { statement; } while (0)
+#else
+#define JSONP_STAT(statement) ((void)0)
+#endif
+
+/* the allocator entry points, falling back on the c library when
+   no allocator has been given */
+JSONP_STATIC void *jsonp_allocate(const jsonp_allocator_t *allocator, size_t size)
+{
+        return allocator ? allocator->alloc(allocator->user, size) : malloc(size);
+}
+
+JSONP_STATIC void *jsonp_reallocate(const jsonp_allocator_t *allocator, void *ptr,
+                                    size_t old_size, size_t new_size)
+{
+        return allocator ? allocator->resize(allocator->user, ptr, old_size, new_size)
+                : realloc(ptr, new_size);
+}
+
+JSONP_STATIC void jsonp_deallocate(const jsonp_allocator_t *allocator, void *ptr, size_t size)
+{
+        if (allocator)
+                allocator->release(allocator->user, ptr, size);
+        else
+                free(ptr);
+}
+
+/* the lexer used by the non-reentrant jsonp_* functions */
+JSONP_STATIC jsonp_lexer_t jsonp_default_lexer;
+
+#ifdef JSONP_DEBUG
+
+JSONP_STATIC int jsonp_push_token_stack(jsonp_lexer_t *lexer, jsonp_token tok);
+JSONP_STATIC jsonp_token jsonp_pop_token_stack(jsonp_lexer_t *lexer);
+JSONP_STATIC int jsonp_empty_token_stack(jsonp_lexer_t *lexer);
 
 #define JSONP_DEBUG_STACK_CAPACITY 20
 
-JSONP_STATIC int jsonp_debug_stack_size = 0;
-JSONP_STATIC int jsonp_debug_stack_ptr = 0;
-JSONP_STATIC char *jsonp_debug_stack[JSONP_DEBUG_STACK_CAPACITY];
+/* the error stack is per-thread, so that lexers running on
+   different threads don't see each other's errors, records are
+   stored inline, the oldest overwritten once it is full */
+JSONP_STATIC JSONP_THREAD_LOCAL int jsonp_debug_stack_size = 0;
+JSONP_STATIC JSONP_THREAD_LOCAL int jsonp_debug_stack_ptr = 0;
+JSONP_STATIC JSONP_THREAD_LOCAL jsonp_error_t jsonp_debug_stack[JSONP_DEBUG_STACK_CAPACITY];
 
-JSONP_STATIC int jsonp_push_error_debug(const char *msg);
-JSONP_STATIC const char *jsonp_pop_error_debug(void);
+JSONP_STATIC const char *jsonp_get_error_init(int status);
+JSONP_STATIC jsonp_error_t *jsonp_push_error_debug(int code, const char *msg);
+JSONP_STATIC void jsonp_locate_error(jsonp_error_t *error, const char *input, size_t size,
+                                     size_t offset, size_t base);
+JSONP_STATIC void jsonp_locate_file_error(jsonp_error_t *error, FILE *fd, size_t offset);
+JSONP_STATIC const jsonp_error_t *jsonp_pop_error_debug(void);
 JSONP_STATIC int jsonp_stack_full_debug(void);
 JSONP_STATIC int jsonp_stack_empty_debug(void);
 
 /* functions to return token primitives */
-JSONP_STATIC jsonp_token jsonp_empty_token();
-JSONP_STATIC jsonp_token jsonp_eof_token();
-JSONP_STATIC jsonp_token jsonp_open_brace_token();
-JSONP_STATIC jsonp_token jsonp_close_brace_token();
-JSONP_STATIC jsonp_token jsonp_open_bracket_token();
-JSONP_STATIC jsonp_token jsonp_close_bracket_token();
-JSONP_STATIC jsonp_token jsonp_string_token();
-JSONP_STATIC jsonp_token jsonp_number_token();
-JSONP_STATIC jsonp_token jsonp_colon_token();
-JSONP_STATIC jsonp_token jsonp_comma_token();
-JSONP_STATIC jsonp_token jsonp_undefined_token();
-JSONP_STATIC jsonp_token jsonp_error_token(const char *msg);
-
-JSONP_STATIC int jsonp_push_token_stack(jsonp_token tok)
-{
-        if (!jsonp_full_token_stack())
-                jsonp_token_stack_size++;
-        jsonp_token_stack[jsonp_token_stack_ptr].type = tok.type;
+JSONP_STATIC jsonp_token jsonp_empty_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_set_token(jsonp_lexer_t *lexer, JSONP_TYPE type,
+                                         const char *data, size_t size);
+JSONP_STATIC jsonp_token jsonp_eof_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_open_brace_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_close_brace_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_open_bracket_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_close_bracket_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_string_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_number_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_colon_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_comma_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_undefined_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_true_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_false_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_null_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_error_token(jsonp_lexer_t *lexer, const char *msg,
+                                           size_t offset);
 
+/* whether @p is within the text held by @buffer */
+JSONP_STATIC int jsonp_buffer_holds(const buffer_t *buffer, const char *p)
+{
+        return buffer->data != NULL && p >= buffer->data && p <= buffer->data + buffer->size;
+}
+
+JSONP_STATIC void jsonp_swap_buffers(buffer_t *a, buffer_t *b)
+{
+        buffer_t t = *a;
+        *a = *b;
+        *b = t;
+}
+
+/* each slot keeps a spare buffer, drawing on the lexer's allocator */
+JSONP_STATIC int jsonp_grow_token_stack(jsonp_lexer_t *lexer)
+{
+        const jsonp_allocator_t *allocator = lexer->tok.token.allocator;
+        int capacity = lexer->token_stack_capacity ? lexer->token_stack_capacity * 2
+                : JSONP_TOKEN_STACK_CAPACITY;
+        jsonp_token *stack = (jsonp_token *)jsonp_allocate(allocator, capacity * sizeof(*stack));
+        if (stack == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+
+        if (lexer->token_stack != NULL) {
+                memcpy(stack, lexer->token_stack, lexer->token_stack_capacity * sizeof(*stack));
+                jsonp_deallocate(allocator, lexer->token_stack,
+                                 lexer->token_stack_capacity * sizeof(*stack));
+        }
+        memset(stack + lexer->token_stack_capacity, 0,
+               (capacity - lexer->token_stack_capacity) * sizeof(*stack));
+        for (int i = lexer->token_stack_capacity; i < capacity; i++)
+                stack[i].token.allocator = allocator;
+        lexer->token_stack = stack;
+        lexer->token_stack_capacity = capacity;
+        return JSONP_NO_ERROR;
+}
+
+/* the text of @tok is left where it is: text in the input, or a
+   literal, stays put, and a buffer of the lexer's holding it is traded
+   for the slot's spare one, so nothing is copied */
+JSONP_STATIC int jsonp_push_token_stack(jsonp_lexer_t *lexer, jsonp_token tok)
+{
         int status;
-        if ((status = jsonp_write_buffer(&jsonp_token_stack[jsonp_token_stack_ptr].token, tok.token.data)) != JSONP_NO_BUFFER_ERROR)
+        if (lexer->token_stack_size == lexer->token_stack_capacity
+            && (status = jsonp_grow_token_stack(lexer)) != JSONP_NO_ERROR)
                 return status;
-        jsonp_token_stack_ptr = (jsonp_token_stack_ptr + 1) % JSONP_TOKEN_STACK_CAPACITY;
+
+        jsonp_token *slot = &lexer->token_stack[lexer->token_stack_size++];
+        if (jsonp_buffer_holds(&lexer->tok.token, tok.view.data))
+                jsonp_swap_buffers(&lexer->tok.token, &slot->token);
+        else if (jsonp_buffer_holds(&lexer->scratch, tok.view.data))
+                jsonp_swap_buffers(&lexer->scratch, &slot->token);
+        slot->type = tok.type;
+        slot->number = tok.number;
+        slot->view = tok.view;
+        JSONP_STAT(lexer->stats.stack_pushes++);
         return JSONP_NO_ERROR;
 }
 
-JSONP_STATIC jsonp_token jsonp_pop_token_stack(void)
+/* text the slot holds is traded back, to be the current token's */
+JSONP_STATIC jsonp_token jsonp_pop_token_stack(jsonp_lexer_t *lexer)
+{
+        if (jsonp_empty_token_stack(lexer))
+                return jsonp_empty_token(lexer);
+
+        JSONP_STAT(lexer->stats.stack_pops++);
+        jsonp_token *slot = &lexer->token_stack[--lexer->token_stack_size];
+        jsonp_token *tok = &lexer->tok;
+        if (jsonp_buffer_holds(&slot->token, slot->view.data)) {
+                jsonp_swap_buffers(&tok->token, &slot->token);
+        } else if (lexer->token_mode == JSONP_TOKEN_COPY) {
+                /* a token that wasn't lexed here, such as one put together
+                   by the caller, is copied as any other would be */
+                jsonp_set_token(lexer, slot->type, slot->view.data, slot->view.size);
+                tok->number = slot->number;
+                return *tok;
+        }
+        tok->type = slot->type;
+        tok->number = slot->number;
+        tok->view = slot->view;
+        return *tok;
+}
+
+JSONP_STATIC int jsonp_empty_token_stack(jsonp_lexer_t *lexer)
 {
-        if (jsonp_empty_token_stack())
-                return jsonp_empty_token();
+        return lexer->token_stack_size == 0;
+}
 
-        jsonp_token_stack_ptr--;
-        jsonp_token_stack_size--;
-        if (jsonp_token_stack_ptr < 0)
-                jsonp_token_stack_ptr += JSONP_TOKEN_STACK_CAPACITY;
+/* record an error of @code, described by @msg, or by the usual
+   description of @code when @msg is NULL; the record is handed back
+   so that a place in the input can be added to it */
+JSONP_STATIC jsonp_error_t *jsonp_push_error_debug(int code, const char *msg)
+{
+        if (!jsonp_stack_full_debug())
+                jsonp_debug_stack_size++;
+        jsonp_error_t *error = &jsonp_debug_stack[jsonp_debug_stack_ptr];
+        jsonp_debug_stack_ptr = (jsonp_debug_stack_ptr + 1) % JSONP_DEBUG_STACK_CAPACITY;
 
-        tok.type = jsonp_token_stack[jsonp_token_stack_ptr].type;
-        jsonp_write_buffer(&tok.token, jsonp_token_stack[jsonp_token_stack_ptr].token.data);
-        return tok;
+        if (msg == NULL)
+                msg = jsonp_get_error_init(code);
+        size_t len = strlen(msg);
+        if (len >= JSONP_ERROR_MESSAGE_CAPACITY)
+                len = JSONP_ERROR_MESSAGE_CAPACITY - 1;
+        error->code = code;
+        memcpy(error->message, msg, len);
+        error->message[len] = '\0';
+        error->offset = JSONP_NO_OFFSET;
+        error->line = error->column = 0;
+        error->snippet[0] = '\0';
+        error->snippet_pos = 0;
+        return error;
 }
 
-JSONP_STATIC int jsonp_empty_token_stack(void)
+/* where the snippet of an error at @offset starts, so that a little of
+   what came before is shown */
+JSONP_STATIC size_t jsonp_snippet_start(size_t offset)
 {
-        return jsonp_token_stack_size == 0;
+        return offset < JSONP_ERROR_SNIPPET_CAPACITY / 4 ? 0 : offset - JSONP_ERROR_SNIPPET_CAPACITY / 4;
 }
 
-JSONP_STATIC int jsonp_full_token_stack(void)
+JSONP_STATIC void jsonp_set_snippet(jsonp_error_t *error, const char *text, size_t size)
 {
-        return jsonp_token_stack_size == JSONP_TOKEN_STACK_CAPACITY;
+        for (size_t i = 0; i < size; i++)
+                error->snippet[i] = (unsigned char)text[i] < 0x20 ? ' ' : text[i];
+        error->snippet[size] = '\0';
 }
 
-JSONP_STATIC int jsonp_push_error_debug(const char *msg)
+/* place @error at @offset in @input, of @size bytes, which starts
+   @base bytes into the whole of the input. lines are counted only
+   now, so that nothing is kept track of while all is well */
+JSONP_STATIC void jsonp_locate_error(jsonp_error_t *error, const char *input, size_t size,
+                                     size_t offset, size_t base)
 {
-        if (msg != NULL) {
-                if (!jsonp_stack_full_debug())
-                        jsonp_debug_stack_size++;
-                if (jsonp_debug_stack[jsonp_debug_stack_ptr] != NULL)
-                        free(jsonp_debug_stack[jsonp_debug_stack_ptr]);
-                if (!(jsonp_debug_stack[jsonp_debug_stack_ptr] = strdup(msg))) {
-                        jsonp_debug_stack_ptr--;
-                        return -1;
-                } else {
-                        jsonp_debug_stack_ptr = (jsonp_debug_stack_ptr + 1)
-                                % JSONP_DEBUG_STACK_CAPACITY;
+        if (offset > size)
+                offset = size;
+        error->offset = base + offset;
+        if (base == 0) {
+                const char *line = input, *p;
+                error->line = 1;
+                while ((p = (const char *)memchr(line, '\n', input + offset - line)) != NULL) {
+                        error->line++;
+                        line = p + 1;
                 }
+                error->column = input + offset - line + 1;
         }
-        return 0;
+
+        size_t start = jsonp_snippet_start(offset);
+        size_t end = size - start < JSONP_ERROR_SNIPPET_CAPACITY - 1
+                ? size : start + JSONP_ERROR_SNIPPET_CAPACITY - 1;
+        jsonp_set_snippet(error, input + start, end - start);
+        error->snippet_pos = (int)(offset - start);
+}
+
+/* as jsonp_locate_error, for a file being read through @fd, which is
+   read again from its start up to @offset, and then put back */
+JSONP_STATIC void jsonp_locate_file_error(jsonp_error_t *error, FILE *fd, size_t offset)
+{
+        char chunk[4096], snippet[JSONP_ERROR_SNIPPET_CAPACITY];
+        size_t start = jsonp_snippet_start(offset), pos = 0, line_start = 0, snippet_size = 0;
+        long saved = ftell(fd);
+        if (saved < 0 || fseek(fd, 0, SEEK_SET) != 0)
+                return;
+
+        error->line = 1;
+        for (;;) {
+                size_t n = fread(chunk, 1, sizeof(chunk), fd);
+                if (n == 0)
+                        break;
+                size_t below = pos >= offset ? 0 : offset - pos < n ? offset - pos : n;
+                const char *p = chunk, *q, *end = chunk + below;
+                while (p < end && (q = (const char *)memchr(p, '\n', end - p)) != NULL) {
+                        error->line++;
+                        line_start = pos + (q - chunk) + 1;
+                        p = q + 1;
+                }
+                if (pos + n > start) {
+                        size_t from = start > pos ? start - pos : 0;
+                        size_t take = n - from;
+                        if (take > JSONP_ERROR_SNIPPET_CAPACITY - 1 - snippet_size)
+                                take = JSONP_ERROR_SNIPPET_CAPACITY - 1 - snippet_size;
+                        memcpy(snippet + snippet_size, chunk + from, take);
+                        snippet_size += take;
+                }
+                pos += n;
+                if (snippet_size == JSONP_ERROR_SNIPPET_CAPACITY - 1)
+                        break;
+        }
+        if (offset > pos)
+                offset = pos;
+
+        error->offset = offset;
+        error->column = offset - line_start + 1;
+        jsonp_set_snippet(error, snippet, snippet_size);
+        error->snippet_pos = (int)(offset - start);
+        clearerr(fd);
+        fseek(fd, saved, SEEK_SET);
 }
 
-JSONP_STATIC const char *jsonp_pop_error_debug(void)
+JSONP_STATIC const jsonp_error_t *jsonp_pop_error_debug(void)
 {
+        static const jsonp_error_t none = { JSONP_NO_ERROR, "No Error", JSONP_NO_OFFSET, 0, 0, "", 0 };
         if (!jsonp_stack_empty_debug()) {
+                jsonp_debug_stack_size--;
                 jsonp_debug_stack_ptr--;
                 if (jsonp_debug_stack_ptr < 0)
                         jsonp_debug_stack_ptr += JSONP_DEBUG_STACK_CAPACITY;
-                return jsonp_debug_stack[jsonp_debug_stack_ptr];
+                return &jsonp_debug_stack[jsonp_debug_stack_ptr];
         }
 
-        return "No Error";
+        return &none;
 }
 
 JSONP_STATIC int jsonp_stack_full_debug(void)
@@ -262,453 +1197,5862 @@ JSONP_STATIC int jsonp_stack_empty_debug(void)
         return jsonp_debug_stack_size == 0;
 }
 
-#define JP_PUSH_ERROR_DEBUG(msg) jp_push_error_debug(msg);
+#define JSONP_PUSH_ERROR_DEBUG(code, msg) ((void)jsonp_push_error_debug((code), (msg)))
 
 #else /* !defined(JSONP_DEBUG) */
 
-#define JP_PUSH_ERROR_DEBUG(msg) void(0)
+#define JSONP_PUSH_ERROR_DEBUG(code, msg) ((void)0)
 
 #endif /* JSONP_DEBUG */
 
-JSONP_STATIC int next_char_file(void)
+/* routines for scanning data held in memory in bulk, each returns
+   the first position from @p that stops the scan, or @end:
+             @scan_whitespace stops at anything other than whitespace
+             @scan_string stops at a '"' or a '\\', or at a byte that is
+                          a control character or isn't ascii
+             @scan_structural stops at a '"' or at a bracket or brace
+*/
+struct jsonp_scanner {
+        const char *(* scan_whitespace)(const char *p, const char *end);
+        const char *(* scan_string)(const char *p, const char *end);
+        const char *(* scan_structural)(const char *p, const char *end);
+};
+
+
+/* read the next character, directly from @input when the data is
+   held in memory, so the common case is a bounds check and a load */
+JSONP_STATIC int jsonp_next_char(jsonp_lexer_t *lexer)
 {
-        return fgetc(curr_fd);
+        if (lexer->input_pos < lexer->input_size)
+                return (unsigned char)lexer->input[lexer->input_pos++];
+        if (lexer->fd) {
+                int c = fgetc(lexer->fd);
+                /* input in memory is counted by its position instead */
+                JSONP_STAT(lexer->stats.bytes += c != EOF);
+                return c;
+        }
+        return EOF;
 }
 
-JSONP_STATIC int next_char_buffer(void)
+JSONP_STATIC int jsonp_is_whitespace(int c)
 {
-        if (curr_buffer_ptr < curr_buffer.size)
-                return curr_buffer.data[curr_buffer_ptr++];
-        return EOF;
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
-JSONP_STATIC jsonp_token jsonp_empty_token()
+JSONP_STATIC const char *jsonp_scan_whitespace_scalar(const char *p, const char *end)
 {
-        memset(&tok, 0, sizeof(tok));
-        if (jsonp_init_buffer(&tok.token) != JSONP_NO_BUFFER_ERROR)
-                return tok;
+        while (p < end && jsonp_is_whitespace((unsigned char)*p))
+                p++;
+        return p;
+}
 
-        tok.type = JSONP_TYPE_EMPTY;
-        jsonp_clear_buffer(&tok.token);
-        return tok;
+/* bytes a string body can hold without being looked at one by one */
+JSONP_STATIC int jsonp_is_plain_string_char(int c)
+{
+        return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
 }
 
-JSONP_STATIC jsonp_token jsonp_eof_token()
+/* looks at eight bytes at a time for a '"' or a '\\', using the
+   usual has-zero-byte trick on the word xor'd with each of them,
+   and for a control character or a non-ascii byte, which is either
+   below 0x20 or has its top bit set */
+JSONP_STATIC const char *jsonp_scan_string_scalar(const char *p, const char *end)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_EOF;
-        jsonp_write_buffer(&tok.token, "EOF");
-        lookahead = next_char();
-        return tok;
+        const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+        while (end - p >= 8) {
+                uint64_t word, quote, backslash;
+                memcpy(&word, p, sizeof(word));
+                quote = word ^ (ones * '"');
+                backslash = word ^ (ones * '\\');
+                if ((((quote - ones) & ~quote) | ((backslash - ones) & ~backslash)
+                     | (word - ones * 0x20) | word) & highs)
+                        break;
+                p += 8;
+        }
+
+        while (p < end && jsonp_is_plain_string_char((unsigned char)*p))
+                p++;
+        return p;
 }
 
-JSONP_STATIC jsonp_token jsonp_open_brace_token()
+JSONP_STATIC int jsonp_is_structural(int c)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_OPEN_BRACE;
-        jsonp_write_buffer(&tok.token, "{");
-        lookahead = next_char();
-        return tok;
+        return c == '"' || c == '{' || c == '}' || c == '[' || c == ']';
 }
 
-JSONP_STATIC jsonp_token jsonp_close_brace_token()
+/* brackets and braces all come out as 0x59 when masked with 0xd9,
+   as do a few other bytes, which the byte at a time loop weeds out */
+JSONP_STATIC const char *jsonp_scan_structural_scalar(const char *p, const char *end)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_CLOSE_BRACE;
-        jsonp_write_buffer(&tok.token, "}");
-        lookahead = next_char();
-        return tok;
+        const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+        while (end - p >= 8) {
+                uint64_t word, quote, bracket;
+                memcpy(&word, p, sizeof(word));
+                quote = word ^ (ones * '"');
+                bracket = (word & (ones * 0xd9)) ^ (ones * 0x59);
+                if ((((quote - ones) & ~quote) | ((bracket - ones) & ~bracket)) & highs)
+                        break;
+                p += 8;
+        }
+
+        while (p < end && !jsonp_is_structural((unsigned char)*p))
+                p++;
+        return p;
 }
 
-JSONP_STATIC jsonp_token jsonp_open_bracket_token()
+#ifdef JSONP_HAVE_SSE2
+
+JSONP_STATIC const char *jsonp_scan_whitespace_sse2(const char *p, const char *end)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_OPEN_BRACKET;
-        jsonp_write_buffer(&tok.token, "[");
-        lookahead = next_char();
-        return tok;
+        const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+        const __m128i newline = _mm_set1_epi8('\n'), ret = _mm_set1_epi8('\r');
+        while (end - p >= 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)p);
+                __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                                       _mm_cmpeq_epi8(v, tab)),
+                                          _mm_or_si128(_mm_cmpeq_epi8(v, newline),
+                                                       _mm_cmpeq_epi8(v, ret)));
+                unsigned mask = ~(unsigned)_mm_movemask_epi8(ws) & 0xffff;
+                if (mask)
+                        return p + jsonp_ctz32(mask);
+                p += 16;
+        }
+        return jsonp_scan_whitespace_scalar(p, end);
 }
 
-JSONP_STATIC jsonp_token jsonp_close_bracket_token()
+JSONP_STATIC const char *jsonp_scan_string_sse2(const char *p, const char *end)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_CLOSE_BRACKET;
-        jsonp_write_buffer(&tok.token, "]");
-        lookahead = next_char();
-        return tok;
+        const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x20);
+        while (end - p >= 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)p);
+                /* the signed compare catches non-ascii bytes as well */
+                unsigned mask = (unsigned)_mm_movemask_epi8(
+                        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                  _mm_cmpeq_epi8(v, backslash)),
+                                     _mm_cmplt_epi8(v, control)));
+                if (mask)
+                        return p + jsonp_ctz32(mask);
+                p += 16;
+        }
+        return jsonp_scan_string_scalar(p, end);
 }
 
-JSONP_STATIC jsonp_token jsonp_string_token()
+JSONP_STATIC const char *jsonp_scan_structural_sse2(const char *p, const char *end)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_STRING;
-        lookahead = next_char();
-        while (lookahead != '"' && lookahead != EOF) {
-                jsonp_append_buffer(&tok.token, lookahead);
-                lookahead = next_char();
+        const __m128i quote = _mm_set1_epi8('"'), mask = _mm_set1_epi8((char)0xd9);
+        const __m128i bracket = _mm_set1_epi8(0x59);
+        while (end - p >= 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)p);
+                unsigned found = (unsigned)_mm_movemask_epi8(
+                        _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                     _mm_cmpeq_epi8(_mm_and_si128(v, mask), bracket)));
+                /* step past bytes that only look like brackets */
+                while (found) {
+                        int i = jsonp_ctz32(found);
+                        if (jsonp_is_structural((unsigned char)p[i]))
+                                return p + i;
+                        found &= found - 1;
+                }
+                p += 16;
         }
+        return jsonp_scan_structural_scalar(p, end);
+}
 
-        if (lookahead == EOF) {
-                tok = jsonp_error_token("Unterminated string");
-        } else {
-                lookahead = next_char();
+#endif /* JSONP_HAVE_SSE2 */
+
+#ifdef JSONP_HAVE_AVX2
+
+__attribute__((target("avx2")))
+JSONP_STATIC const char *jsonp_scan_whitespace_avx2(const char *p, const char *end)
+{
+        const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+        const __m256i newline = _mm256_set1_epi8('\n'), ret = _mm256_set1_epi8('\r');
+        while (end - p >= 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)p);
+                __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                                             _mm256_cmpeq_epi8(v, tab)),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(v, newline),
+                                                             _mm256_cmpeq_epi8(v, ret)));
+                unsigned mask = ~(unsigned)_mm256_movemask_epi8(ws);
+                if (mask)
+                        return p + jsonp_ctz32(mask);
+                p += 32;
         }
-        return tok;
+        return jsonp_scan_whitespace_sse2(p, end);
 }
 
-JSONP_STATIC jsonp_token jsonp_number_token()
+__attribute__((target("avx2")))
+JSONP_STATIC const char *jsonp_scan_string_avx2(const char *p, const char *end)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_NUMBER;
-        while ((lookahead >= '0' && lookahead <= '9')) {
-                jsonp_append_buffer(&tok.token, lookahead);
-                lookahead = next_char();
+        const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+        const __m256i control = _mm256_set1_epi8(0x20);
+        while (end - p >= 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)p);
+                unsigned mask = (unsigned)_mm256_movemask_epi8(
+                        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                        _mm256_cmpeq_epi8(v, backslash)),
+                                        _mm256_cmpgt_epi8(control, v)));
+                if (mask)
+                        return p + jsonp_ctz32(mask);
+                p += 32;
         }
+        return jsonp_scan_string_sse2(p, end);
+}
 
-        if (lookahead == '.') {
-                jsonp_append_buffer(&tok.token, lookahead);
-                lookahead = next_char();
-                while ((lookahead >= '0' && lookahead <= '9')) {
-                        jsonp_append_buffer(&tok.token, lookahead);
-                        lookahead = next_char();
+__attribute__((target("avx2")))
+JSONP_STATIC const char *jsonp_scan_structural_avx2(const char *p, const char *end)
+{
+        const __m256i quote = _mm256_set1_epi8('"'), mask = _mm256_set1_epi8((char)0xd9);
+        const __m256i bracket = _mm256_set1_epi8(0x59);
+        while (end - p >= 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)p);
+                unsigned found = (unsigned)_mm256_movemask_epi8(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                        _mm256_cmpeq_epi8(_mm256_and_si256(v, mask), bracket)));
+                while (found) {
+                        int i = jsonp_ctz32(found);
+                        if (jsonp_is_structural((unsigned char)p[i]))
+                                return p + i;
+                        found &= found - 1;
                 }
+                p += 32;
         }
-        return tok;
+        return jsonp_scan_structural_sse2(p, end);
 }
 
-JSONP_STATIC jsonp_token jsonp_colon_token()
+#endif /* JSONP_HAVE_AVX2 */
+
+JSONP_STATIC const struct jsonp_scanner jsonp_scanner_scalar = {
+        jsonp_scan_whitespace_scalar,
+        jsonp_scan_string_scalar,
+        jsonp_scan_structural_scalar,
+};
+
+#ifdef JSONP_HAVE_SSE2
+JSONP_STATIC const struct jsonp_scanner jsonp_scanner_sse2 = {
+        jsonp_scan_whitespace_sse2,
+        jsonp_scan_string_sse2,
+        jsonp_scan_structural_sse2,
+};
+#endif
+
+#ifdef JSONP_HAVE_AVX2
+JSONP_STATIC const struct jsonp_scanner jsonp_scanner_avx2 = {
+        jsonp_scan_whitespace_avx2,
+        jsonp_scan_string_avx2,
+        jsonp_scan_structural_avx2,
+};
+#endif
+
+/* pick the widest scanner the running cpu supports */
+JSONP_STATIC const struct jsonp_scanner *jsonp_select_scanner(void)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_COLON;
-        jsonp_write_buffer(&tok.token, ":");
-        lookahead = next_char();
-        return tok;
+#ifdef JSONP_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2"))
+                return &jsonp_scanner_avx2;
+#endif
+#ifdef JSONP_HAVE_SSE2
+        return &jsonp_scanner_sse2;
+#else
+        return &jsonp_scanner_scalar;
+#endif
 }
 
-JSONP_STATIC jsonp_token jsonp_comma_token()
+/* skip the whitespace starting at @lookahead, jumping over the
+   whole run at once when the data is held in memory */
+JSONP_STATIC void jsonp_skip_whitespace(jsonp_lexer_t *lexer)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_COMMA;
-        jsonp_write_buffer(&tok.token, ",");
-        lookahead = next_char();
-        return tok;
+        if (lexer->fd) {
+                while (jsonp_is_whitespace(lexer->lookahead))
+                        lexer->lookahead = jsonp_next_char(lexer);
+                return;
+        }
+
+        const char *p = lexer->scanner->scan_whitespace(lexer->input + lexer->input_pos,
+                                                        lexer->input + lexer->input_size);
+        lexer->input_pos = p - lexer->input;
+        lexer->lookahead = jsonp_next_char(lexer);
 }
 
-JSONP_STATIC jsonp_token jsonp_undefined_token()
+/* offset of @lookahead within @input */
+JSONP_STATIC size_t jsonp_lookahead_offset(jsonp_lexer_t *lexer)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_UNDEFINED;
-        jsonp_write_buffer(&tok.token, "UNDEFINED");
-        lookahead = next_char();
-        return tok;
+        return lexer->lookahead == EOF ? lexer->input_size : lexer->input_pos - 1;
 }
 
-JSONP_STATIC jsonp_token jsonp_error_token(const char *msg)
+/* the offset of the lookahead, also for a file, whose position is
+   only asked for once something has gone wrong */
+JSONP_STATIC size_t jsonp_error_position(jsonp_lexer_t *lexer)
 {
-        tok = jsonp_empty_token();
-        tok.type = JSONP_TYPE_ERROR;
-        if (msg != NULL)
-                jsonp_write_buffer(&tok.token, msg);
-        else
-                jsonp_write_buffer(&tok.token, "Error: no description");
-        return tok;
+        if (lexer->fd) {
+                long pos = ftell(lexer->fd);
+                return pos <= 0 ? 0 : (size_t)pos - (lexer->lookahead != EOF);
+        }
+        return jsonp_lookahead_offset(lexer);
 }
 
-JSONP_STATIC const char *jsonp_get_error_init(int status)
+/* token text is captured in place for data held in memory, and only
+   needs to be collected into @scratch when reading from a file */
+JSONP_STATIC void jsonp_begin_capture(jsonp_lexer_t *lexer)
 {
-        static const char *msgs[JSONP_ERROR_COUNT] = {
-                "No Error",
-                "File does not exist!",
-                "Could not create buffer!",
-        };
+        if (lexer->fd) {
+                lexer->scratch.size = 0;
+                if (lexer->scratch.data == NULL)
+                        jsonp_init_buffer(&lexer->scratch);
+        } else {
+                lexer->capture_start = jsonp_lookahead_offset(lexer);
+        }
+}
 
-        return (status >= 0 && status < JSONP_ERROR_COUNT
-            ? msgs[status] : "Undefined Error!");
+JSONP_STATIC void jsonp_capture_char(jsonp_lexer_t *lexer)
+{
+        if (lexer->fd)
+                jsonp_append_buffer(&lexer->scratch, lexer->lookahead);
 }
 
-JSONP_EXTERN jsonp_info_t jsonp_create_json_info(JSONP_INFO_DATA_TYPE type,
-                                              const char *data)
+JSONP_STATIC jsonp_view_t jsonp_end_capture(jsonp_lexer_t *lexer)
 {
-        JSONP_INFO_DATA_TYPE my_type = type;
-        const char *my_data = data;
-        if (type < 0 || type >= JSONP_INFO_DATA_COUNT)
-                type = JSONP_TEXT;
+        jsonp_view_t view;
+        if (lexer->fd) {
+                view.data = lexer->scratch.data;
+                view.size = lexer->scratch.size;
+        } else {
+                view.data = lexer->input + lexer->capture_start;
+                view.size = jsonp_lookahead_offset(lexer) - lexer->capture_start;
+        }
+        return view;
+}
 
-        return (jsonp_info_t) {
-                .type = type,
-                .data = data
-        };
+/* a token starting at @start in @input ran into the end of the data
+   fed to a stream, so step back to its first character and ask for
+   more, it is lexed again from the start after the next jsonp_feed */
+JSONP_STATIC jsonp_token jsonp_need_more_token(jsonp_lexer_t *lexer, size_t start)
+{
+        lexer->input_pos = start + 1;
+        lexer->lookahead = (unsigned char)lexer->input[start];
+        return jsonp_set_token(lexer, JSONP_TYPE_NEED_MORE, "", 0);
 }
 
-JSONP_EXTERN int jsonp_init(jsonp_info_t info)
+JSONP_STATIC jsonp_token jsonp_empty_token(jsonp_lexer_t *lexer)
 {
-        tok = jsonp_empty_token();
-        curr_buffer_ptr = 0;
+        return jsonp_set_token(lexer, JSONP_TYPE_EMPTY, "", 0);
+}
 
-        switch (info.type) {
-        case JSONP_FILE:
-                next_char = next_char_file;
-                curr_fd = fopen(info.data, "r");
-                if (!curr_fd) {
-                        jsonp_push_error_debug(jsonp_get_error_init(JSONP_FILE_ERROR));
-                        return JSONP_FILE_ERROR;
-                }
-                break;
-        case JSONP_TEXT:
-        default: /* JSONP_TEXT is also the default case */
-                next_char = next_char_buffer;
-                jsonp_init_buffer(&curr_buffer);
-                jsonp_write_buffer(&curr_buffer, info.data);
-                if (jsonp_had_error()) {
-                        jsonp_push_error_debug(jsonp_get_error_init(JSONP_BUFFER_ERROR));
-                        return JSONP_BUFFER_ERROR;
-                }
-                break;
+/* set the current token to @type, with @size bytes of text at @data,
+   which is copied only when the lexer is in JSONP_TOKEN_COPY mode */
+JSONP_STATIC jsonp_token jsonp_set_token(jsonp_lexer_t *lexer, JSONP_TYPE type,
+                                         const char *data, size_t size)
+{
+        jsonp_token *tok = &lexer->tok;
+        tok->type = type;
+        tok->view.data = data;
+        tok->view.size = size;
+        if (lexer->token_mode == JSONP_TOKEN_COPY) {
+                if (tok->token.data == NULL
+                    && jsonp_init_buffer(&tok->token) != JSONP_NO_BUFFER_ERROR)
+                        return *tok;
+                jsonp_write_n_buffer(&tok->token, data, size);
+                tok->view.data = tok->token.data;
         }
+        return *tok;
+}
 
-        lookahead = next_char();
-        return JSONP_NO_ERROR;
+JSONP_STATIC jsonp_token jsonp_eof_token(jsonp_lexer_t *lexer)
+{
+        jsonp_set_token(lexer, JSONP_TYPE_EOF, "EOF", 3);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
 }
 
-JSONP_EXTERN int jsonp_free(void)
+JSONP_STATIC jsonp_token jsonp_open_brace_token(jsonp_lexer_t *lexer)
 {
-        if (curr_fd) {
-                fclose(curr_fd);
-                curr_fd = NULL;
-        }
+        jsonp_set_token(lexer, JSONP_TYPE_OPEN_BRACE, "{", 1);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
+}
 
-        jsonp_free_buffer(&curr_buffer);
+JSONP_STATIC jsonp_token jsonp_close_brace_token(jsonp_lexer_t *lexer)
+{
+        jsonp_set_token(lexer, JSONP_TYPE_CLOSE_BRACE, "}", 1);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
+}
 
-        return JSONP_NO_ERROR;
+JSONP_STATIC jsonp_token jsonp_open_bracket_token(jsonp_lexer_t *lexer)
+{
+        jsonp_set_token(lexer, JSONP_TYPE_OPEN_BRACKET, "[", 1);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
 }
 
-JSONP_STATIC const char *jsonp_get_error_buffer(int status)
+JSONP_STATIC jsonp_token jsonp_close_bracket_token(jsonp_lexer_t *lexer)
 {
-        static const char *msgs[JSONP_BUFFER_ERRORS_COUNT] = {
-                "No error",
-                "buffer was null!",
-                "data was null!",
-                "failed to resize buffer!",
+        jsonp_set_token(lexer, JSONP_TYPE_CLOSE_BRACKET, "]", 1);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
+}
+
+/* ways decoding the body of a string can fail */
+typedef enum {
+        JSONP_STRING_OK = 0,
+        JSONP_STRING_TRUNCATED,
+        JSONP_STRING_BAD_ESCAPE,
+        JSONP_STRING_BAD_UTF8,
+        JSONP_STRING_CONTROL,
+        JSONP_STRING_STATUS_COUNT
+} JSONP_STRING_STATUS;
+
+JSONP_STATIC const char *jsonp_get_error_string(int status)
+{
+        static const char *msgs[JSONP_STRING_STATUS_COUNT] = {
+                "No Error",
+                "Unterminated string",
+                "Invalid escape in string",
+                "Invalid UTF-8 in string",
+                "Control character in string",
         };
 
-        return (status >= 0 && status < JSONP_BUFFER_ERRORS_COUNT
-                ? msgs[status] : "Unknown Error");
+        return (status >= 0 && status < JSONP_STRING_STATUS_COUNT
+            ? msgs[status] : "Undefined Error!");
 }
 
-JSONP_EXTERN int jsonp_init_buffer(buffer_t *buffer)
+/* length of the utf-8 sequence starting at @p, rejecting overlong
+   forms, surrogates and anything past U+10FFFF; returns 0 when it is
+   malformed, or -1 when it runs past @end */
+JSONP_STATIC int jsonp_utf8_length(const char *p, const char *end)
 {
-        if (buffer == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
-                return JSONP_NULL_BUFFER_ERROR;
+        const unsigned char *s = (const unsigned char *)p;
+        unsigned char low = 0x80, high = 0xbf;
+        int size;
+
+        if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+                size = 2;
+        } else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+                size = 3;
+                if (s[0] == 0xe0)
+                        low = 0xa0;
+                else if (s[0] == 0xed)
+                        high = 0x9f;
+        } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+                size = 4;
+                if (s[0] == 0xf0)
+                        low = 0x90;
+                else if (s[0] == 0xf4)
+                        high = 0x8f;
+        } else {
+                return 0;
+        }
+
+        for (int i = 1; i < size; i++) {
+                if (p + i >= end)
+                        return -1;
+                if (s[i] < low || s[i] > high)
+                        return 0;
+                low = 0x80;
+                high = 0xbf;
+        }
+        return size;
+}
+
+/* read the \\u and four hex digits at @p into @code; returns the
+   status, which is truncated only if what there is of them is valid */
+JSONP_STATIC int jsonp_parse_unicode_escape(const char *p, const char *end, uint32_t *code)
+{
+        *code = 0;
+        for (int i = 0; i < 6; i++) {
+                int c, digit;
+                if (p + i >= end)
+                        return JSONP_STRING_TRUNCATED;
+                c = (unsigned char)p[i];
+                if (i < 2) {
+                        if (c != "\\u"[i])
+                                return JSONP_STRING_BAD_ESCAPE;
+                        continue;
+                }
+                if (c >= '0' && c <= '9')
+                        digit = c - '0';
+                else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                        digit = (c | 0x20) - 'a' + 10;
+                else
+                        return JSONP_STRING_BAD_ESCAPE;
+                *code = (*code << 4) | digit;
+        }
+        return JSONP_STRING_OK;
+}
+
+JSONP_STATIC int jsonp_encode_utf8(uint32_t code, char *out)
+{
+        if (code < 0x80) {
+                out[0] = (char)code;
+                return 1;
+        }
+        if (code < 0x800) {
+                out[0] = (char)(0xc0 | (code >> 6));
+                out[1] = (char)(0x80 | (code & 0x3f));
+                return 2;
+        }
+        if (code < 0x10000) {
+                out[0] = (char)(0xe0 | (code >> 12));
+                out[1] = (char)(0x80 | ((code >> 6) & 0x3f));
+                out[2] = (char)(0x80 | (code & 0x3f));
+                return 3;
+        }
+        out[0] = (char)(0xf0 | (code >> 18));
+        out[1] = (char)(0x80 | ((code >> 12) & 0x3f));
+        out[2] = (char)(0x80 | ((code >> 6) & 0x3f));
+        out[3] = (char)(0x80 | (code & 0x3f));
+        return 4;
+}
+
+/* decode the escape starting with the '\\' at @p into @out, a pair
+   of \u escapes for a surrogate pair is decoded as one character;
+   returns the number of bytes written, or the negated status when
+   the escape is invalid or runs past @end */
+JSONP_STATIC int jsonp_decode_escape(const char *p, const char *end, char *out, size_t *consumed)
+{
+        uint32_t code, low;
+        int status;
+        if (end - p < 2)
+                return -JSONP_STRING_TRUNCATED;
+
+        *consumed = 2;
+        switch (p[1]) {
+        case '"': *out = '"'; return 1;
+        case '\\': *out = '\\'; return 1;
+        case '/': *out = '/'; return 1;
+        case 'b': *out = '\b'; return 1;
+        case 'f': *out = '\f'; return 1;
+        case 'n': *out = '\n'; return 1;
+        case 'r': *out = '\r'; return 1;
+        case 't': *out = '\t'; return 1;
+        case 'u':
+                break;
+        default:
+                return -JSONP_STRING_BAD_ESCAPE;
+        }
+
+        if ((status = jsonp_parse_unicode_escape(p, end, &code)) != JSONP_STRING_OK)
+                return -status;
+        if (code >= 0xdc00 && code <= 0xdfff)
+                return -JSONP_STRING_BAD_ESCAPE;
+
+        *consumed = 6;
+        if (code >= 0xd800 && code <= 0xdbff) {
+                if ((status = jsonp_parse_unicode_escape(p + 6, end, &low)) != JSONP_STRING_OK)
+                        return -status;
+                if (low < 0xdc00 || low > 0xdfff)
+                        return -JSONP_STRING_BAD_ESCAPE;
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                *consumed = 12;
+        }
+        return jsonp_encode_utf8(code, out);
+}
+
+/* append decoded string text, either over the text already decoded
+   at @out, which never overtakes the text still to be decoded, or
+   into @scratch */
+JSONP_STATIC void jsonp_put_string(jsonp_lexer_t *lexer, char **out,
+                                   const char *data, size_t size)
+{
+        if (*out == NULL) {
+                jsonp_append_n_buffer(&lexer->scratch, data, (int)size);
+        } else {
+                if (*out != data) {
+                        memmove(*out, data, size);
+                        lexer->rewritten |= lexer->in_place;
+                }
+                *out += size;
+        }
+}
+
+/* decode the body of the string at @p up to its closing quote, and
+   check that it is valid utf-8 on the way; @text is pointed at the
+   body in the input when it has no escapes, otherwise at the decoded
+   text, which is written over the input when @in_place is set, or
+   into @scratch when it isn't; @stop is set to the closing quote, or
+   to where decoding failed */
+JSONP_STATIC int jsonp_decode_string(jsonp_lexer_t *lexer, const char *p, const char *end,
+                                     int in_place, const char **stop, jsonp_view_t *text)
+{
+        const char *start = p, *run = p;
+        char *out = NULL;
+        int escaped = 0, status;
+
+        for (;;) {
+                p = lexer->scanner->scan_string(p, end);
+                if (p >= end) {
+                        status = JSONP_STRING_TRUNCATED;
+                        break;
+                }
+
+                unsigned char c = (unsigned char)*p;
+                if (c == '"') {
+                        status = JSONP_STRING_OK;
+                        break;
+                }
+
+                if (c >= 0x80) {
+                        int size = jsonp_utf8_length(p, end);
+                        if (size <= 0) {
+                                status = size < 0 ? JSONP_STRING_TRUNCATED : JSONP_STRING_BAD_UTF8;
+                                break;
+                        }
+                        p += size;
+                        continue;
+                }
+
+                if (c != '\\') {
+                        status = JSONP_STRING_CONTROL;
+                        break;
+                }
+
+                /* only strings with escapes are copied anywhere */
+                if (!escaped) {
+                        escaped = 1;
+                        if (in_place) {
+                                out = (char *)start;
+                        } else {
+                                if (lexer->scratch.data == NULL)
+                                        jsonp_init_buffer(&lexer->scratch);
+                                lexer->scratch.size = 0;
+                        }
+                }
+
+                char decoded[4];
+                size_t consumed;
+                int size = jsonp_decode_escape(p, end, decoded, &consumed);
+                if (size < 0) {
+                        status = -size;
+                        break;
+                }
+                jsonp_put_string(lexer, &out, run, p - run);
+                jsonp_put_string(lexer, &out, decoded, size);
+                p += consumed;
+                run = p;
+        }
+
+        *stop = p;
+        if (status != JSONP_STRING_OK)
+                return status;
+
+        if (!escaped) {
+                text->data = start;
+                text->size = p - start;
+        } else {
+                jsonp_put_string(lexer, &out, run, p - run);
+                text->data = in_place ? start : lexer->scratch.data;
+                text->size = in_place ? (size_t)(out - start) : (size_t)lexer->scratch.size;
+        }
+        return JSONP_STRING_OK;
+}
+
+/* find the closing quote of a string from @p, stepping over escapes,
+   so lexing can carry on after a string that failed to decode */
+JSONP_STATIC const char *jsonp_skip_string(jsonp_lexer_t *lexer, const char *p, const char *end)
+{
+        while ((p = lexer->scanner->scan_string(p, end)) < end) {
+                if (*p == '"')
+                        return p;
+                p += *p == '\\' ? 2 : 1;
+        }
+        return NULL;
+}
+
+JSONP_STATIC jsonp_token jsonp_string_token(jsonp_lexer_t *lexer)
+{
+        jsonp_view_t text;
+        const char *stop;
+        int status;
+
+        if (!lexer->fd) {
+                const char *start = lexer->input + lexer->input_pos;
+                const char *end = lexer->input + lexer->input_size;
+                size_t fault = 0;
+                lexer->capture_start = lexer->input_pos - 1;
+                status = jsonp_decode_string(lexer, start, end, lexer->in_place, &stop, &text);
+                if (status != JSONP_STRING_OK && status != JSONP_STRING_TRUNCATED) {
+                        fault = stop - lexer->input;
+                        if ((stop = jsonp_skip_string(lexer, stop, end)) == NULL)
+                                status = JSONP_STRING_TRUNCATED;
+                }
+
+                if (status == JSONP_STRING_TRUNCATED && lexer->stream_open)
+                        return jsonp_need_more_token(lexer, lexer->capture_start);
+                if (status == JSONP_STRING_TRUNCATED) {
+                        lexer->input_pos = lexer->input_size;
+                        lexer->lookahead = EOF;
+                        return jsonp_error_token(lexer, jsonp_get_error_string(status),
+                                                 lexer->capture_start);
+                }
+
+                lexer->input_pos = stop + 1 - lexer->input;
+                lexer->lookahead = jsonp_next_char(lexer);
+                if (status != JSONP_STRING_OK)
+                        return jsonp_error_token(lexer, jsonp_get_error_string(status), fault);
+                return jsonp_set_token(lexer, JSONP_TYPE_STRING, text.data, text.size);
+        }
+
+        /* the raw body is collected, along with its closing quote, and
+           then decoded where it is in @scratch */
+        lexer->lookahead = jsonp_next_char(lexer);
+        jsonp_begin_capture(lexer);
+        while (lexer->lookahead != '"' && lexer->lookahead != EOF) {
+                if (lexer->lookahead == '\\') {
+                        jsonp_capture_char(lexer);
+                        lexer->lookahead = jsonp_next_char(lexer);
+                        if (lexer->lookahead == EOF)
+                                break;
+                }
+                jsonp_capture_char(lexer);
+                lexer->lookahead = jsonp_next_char(lexer);
+        }
+
+        if (lexer->lookahead == EOF)
+                return jsonp_error_token(lexer, jsonp_get_error_string(JSONP_STRING_TRUNCATED),
+                                         jsonp_error_position(lexer) - lexer->scratch.size - 1);
+
+        jsonp_capture_char(lexer);
+        status = jsonp_decode_string(lexer, lexer->scratch.data,
+                                     lexer->scratch.data + lexer->scratch.size,
+                                     1, &stop, &text);
+        lexer->lookahead = jsonp_next_char(lexer);
+        /* @scratch holds the body from just after the opening quote */
+        if (status != JSONP_STRING_OK)
+                return jsonp_error_token(lexer, jsonp_get_error_string(status),
+                                         jsonp_error_position(lexer) - lexer->scratch.size
+                                         + (stop - lexer->scratch.data));
+        return jsonp_set_token(lexer, JSONP_TYPE_STRING, text.data, text.size);
+}
+
+/* characters that can make up a number, used to find where a
+   malformed number ends */
+JSONP_STATIC int jsonp_is_number_char(int c)
+{
+        return (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E'
+                || c == '+' || c == '-';
+}
+
+/* characters that would run on from the end of a literal */
+JSONP_STATIC int jsonp_is_word_char(int c)
+{
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                || (c >= '0' && c <= '9') || c == '_';
+}
+
+/* checks eight bytes at once, each must have a high nibble of 3 and
+   stay below 0x3a when 6 is added to it */
+JSONP_STATIC int jsonp_is_eight_digits(const char *p)
+{
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        return (word & 0xf0f0f0f0f0f0f0f0ULL) == 0x3030303030303030ULL
+                && ((word + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL)
+                == 0x3030303030303030ULL;
+}
+
+JSONP_STATIC const char *jsonp_scan_digits(const char *p, const char *end)
+{
+        while (end - p >= 8 && jsonp_is_eight_digits(p))
+                p += 8;
+        while (p < end && *p >= '0' && *p <= '9')
+                p++;
+        return p;
+}
+
+/* match the json number grammar,
+       -? (0 | [1-9][0-9]*) (. [0-9]+)? ([eE] [+-]? [0-9]+)?
+   from @p, storing where the match stopped in @stop; returns non-zero
+   when a complete number ends at @stop */
+JSONP_STATIC int jsonp_scan_number(const char *p, const char *end, const char **stop)
+{
+        const char *digits;
+        if (p < end && *p == '-')
+                p++;
+
+        if (p < end && *p == '0')
+                p++;
+        else if (p < end && *p >= '1' && *p <= '9')
+                p = jsonp_scan_digits(p + 1, end);
+        else
+                goto malformed;
+
+        if (p < end && *p == '.') {
+                digits = ++p;
+                if ((p = jsonp_scan_digits(p, end)) == digits)
+                        goto malformed;
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+                p++;
+                if (p < end && (*p == '+' || *p == '-'))
+                        p++;
+                digits = p;
+                if ((p = jsonp_scan_digits(p, end)) == digits)
+                        goto malformed;
+        }
+
+        *stop = p;
+        return p == end || !jsonp_is_number_char((unsigned char)*p);
+malformed:
+        *stop = p;
+        return 0;
+}
+
+/* 128-bit approximations of the powers of five from 5^-342 to 5^308,
+   normalised so the top bit is set, used by jsonp_eisel_lemire */
+#define JSONP_POW5_MIN_EXP10 -342
+#define JSONP_POW5_MAX_EXP10 308
+static const uint64_t jsonp_pow5_table[][2] = {
+        {0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL},
+        {0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL},
+        {0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL},
+        {0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL},
+        {0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL},
+        {0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL},
+        {0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL},
+        {0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL},
+        {0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL},
+        {0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL},
+        {0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL},
+        {0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL},
+        {0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL},
+        {0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL},
+        {0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL},
+        {0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL},
+        {0x84a57695fe98746dULL, 0x014bb630f7604b57ULL},
+        {0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL},
+        {0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL},
+        {0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL},
+        {0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL},
+        {0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL},
+        {0xfd00b897478238d0ULL, 0x8920b098955522b4ULL},
+        {0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL},
+        {0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL},
+        {0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL},
+        {0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL},
+        {0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL},
+        {0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL},
+        {0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL},
+        {0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL},
+        {0xeba09271e88d976bULL, 0xf7864a44c633682eULL},
+        {0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL},
+        {0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL},
+        {0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL},
+        {0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL},
+        {0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL},
+        {0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL},
+        {0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL},
+        {0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL},
+        {0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL},
+        {0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL},
+        {0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL},
+        {0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL},
+        {0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL},
+        {0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL},
+        {0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL},
+        {0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL},
+        {0xa37fce126597973cULL, 0xe50ff107bab528a0ULL},
+        {0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL},
+        {0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL},
+        {0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL},
+        {0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL},
+        {0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL},
+        {0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL},
+        {0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL},
+        {0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL},
+        {0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL},
+        {0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL},
+        {0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL},
+        {0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL},
+        {0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL},
+        {0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL},
+        {0x91376c36d99995beULL, 0x23100809b9c21fa1ULL},
+        {0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL},
+        {0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL},
+        {0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL},
+        {0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL},
+        {0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL},
+        {0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL},
+        {0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL},
+        {0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL},
+        {0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL},
+        {0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL},
+        {0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL},
+        {0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL},
+        {0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL},
+        {0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL},
+        {0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL},
+        {0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL},
+        {0xc987434744ac874eULL, 0xa327ffb266b56220ULL},
+        {0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL},
+        {0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL},
+        {0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL},
+        {0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL},
+        {0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL},
+        {0xc0314325637a1939ULL, 0xfa911155fefb5308ULL},
+        {0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL},
+        {0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL},
+        {0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL},
+        {0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL},
+        {0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL},
+        {0xb749faed14125d36ULL, 0xcef980ec671f667bULL},
+        {0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL},
+        {0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL},
+        {0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL},
+        {0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL},
+        {0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL},
+        {0xaecc49914078536dULL, 0x58fae9f773886e18ULL},
+        {0xda7f5bf590966848ULL, 0xaf39a475506a899eULL},
+        {0x888f99797a5e012dULL, 0x6d8406c952429603ULL},
+        {0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL},
+        {0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL},
+        {0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL},
+        {0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL},
+        {0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL},
+        {0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL},
+        {0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL},
+        {0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL},
+        {0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL},
+        {0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL},
+        {0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL},
+        {0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL},
+        {0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL},
+        {0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL},
+        {0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL},
+        {0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL},
+        {0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL},
+        {0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL},
+        {0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL},
+        {0xb913179899f68584ULL, 0x28e2557b59846e3fULL},
+        {0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL},
+        {0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL},
+        {0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL},
+        {0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL},
+        {0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL},
+        {0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL},
+        {0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL},
+        {0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL},
+        {0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL},
+        {0xd77485cb25823ac7ULL, 0x7d633293366b828bULL},
+        {0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL},
+        {0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL},
+        {0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL},
+        {0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL},
+        {0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL},
+        {0xcd795be870516656ULL, 0x67902e276c921f8bULL},
+        {0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL},
+        {0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL},
+        {0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL},
+        {0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL},
+        {0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL},
+        {0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL},
+        {0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL},
+        {0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL},
+        {0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL},
+        {0xef340a98172aace4ULL, 0x86fb897116c87c34ULL},
+        {0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL},
+        {0xbae0a846d2195712ULL, 0x8974836059cca109ULL},
+        {0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL},
+        {0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL},
+        {0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL},
+        {0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL},
+        {0x8e938662882af53eULL, 0x547eb47b7282ee9cULL},
+        {0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL},
+        {0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL},
+        {0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL},
+        {0xae0b158b4738705eULL, 0x9624ab50b148d445ULL},
+        {0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL},
+        {0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL},
+        {0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL},
+        {0xd47487cc8470652bULL, 0x7647c3200069671fULL},
+        {0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL},
+        {0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL},
+        {0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL},
+        {0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL},
+        {0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL},
+        {0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL},
+        {0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL},
+        {0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL},
+        {0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL},
+        {0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL},
+        {0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL},
+        {0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL},
+        {0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL},
+        {0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL},
+        {0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL},
+        {0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL},
+        {0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL},
+        {0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL},
+        {0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL},
+        {0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL},
+        {0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL},
+        {0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL},
+        {0x8c974f7383725573ULL, 0x1e414218c73a13fbULL},
+        {0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL},
+        {0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL},
+        {0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL},
+        {0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL},
+        {0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL},
+        {0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL},
+        {0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL},
+        {0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL},
+        {0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL},
+        {0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL},
+        {0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL},
+        {0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL},
+        {0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL},
+        {0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL},
+        {0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL},
+        {0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL},
+        {0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL},
+        {0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL},
+        {0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL},
+        {0xbe89523386091465ULL, 0xf6bbb397f1135823ULL},
+        {0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL},
+        {0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL},
+        {0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL},
+        {0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL},
+        {0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL},
+        {0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL},
+        {0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL},
+        {0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL},
+        {0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL},
+        {0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL},
+        {0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL},
+        {0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL},
+        {0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL},
+        {0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL},
+        {0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL},
+        {0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL},
+        {0x843610cb4bf160cbULL, 0xcedf722a585139baULL},
+        {0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL},
+        {0xce947a3da6a9273eULL, 0x733d226229feea32ULL},
+        {0x811ccc668829b887ULL, 0x0806357d5a3f525fULL},
+        {0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL},
+        {0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL},
+        {0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL},
+        {0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL},
+        {0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL},
+        {0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL},
+        {0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL},
+        {0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL},
+        {0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL},
+        {0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL},
+        {0xbbe226efb628afeaULL, 0x890489f70a55368bULL},
+        {0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL},
+        {0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL},
+        {0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL},
+        {0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL},
+        {0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL},
+        {0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL},
+        {0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL},
+        {0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL},
+        {0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL},
+        {0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL},
+        {0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL},
+        {0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL},
+        {0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL},
+        {0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL},
+        {0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL},
+        {0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL},
+        {0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL},
+        {0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL},
+        {0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL},
+        {0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL},
+        {0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL},
+        {0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL},
+        {0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL},
+        {0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL},
+        {0xc24452da229b021bULL, 0xfbe85badce996168ULL},
+        {0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL},
+        {0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL},
+        {0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL},
+        {0xed246723473e3813ULL, 0x290123e9aab23b68ULL},
+        {0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL},
+        {0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL},
+        {0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL},
+        {0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL},
+        {0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL},
+        {0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL},
+        {0x8d590723948a535fULL, 0x579c487e5a38ad0eULL},
+        {0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL},
+        {0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL},
+        {0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL},
+        {0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL},
+        {0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL},
+        {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL},
+        {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL},
+        {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL},
+        {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL},
+        {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL},
+        {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL},
+        {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL},
+        {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL},
+        {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL},
+        {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL},
+        {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL},
+        {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL},
+        {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL},
+        {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL},
+        {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL},
+        {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL},
+        {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL},
+        {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL},
+        {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL},
+        {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL},
+        {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL},
+        {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL},
+        {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL},
+        {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL},
+        {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL},
+        {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL},
+        {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL},
+        {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL},
+        {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL},
+        {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL},
+        {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL},
+        {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL},
+        {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL},
+        {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL},
+        {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL},
+        {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL},
+        {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL},
+        {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL},
+        {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL},
+        {0xc612062576589ddaULL, 0x95364afe032a819eULL},
+        {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL},
+        {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL},
+        {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL},
+        {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL},
+        {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL},
+        {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL},
+        {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL},
+        {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL},
+        {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL},
+        {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL},
+        {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL},
+        {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL},
+        {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL},
+        {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL},
+        {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL},
+        {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL},
+        {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL},
+        {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL},
+        {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL},
+        {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL},
+        {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL},
+        {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL},
+        {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL},
+        {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL},
+        {0xccccccccccccccccULL, 0xcccccccccccccccdULL},
+        {0x8000000000000000ULL, 0x0000000000000000ULL},
+        {0xa000000000000000ULL, 0x0000000000000000ULL},
+        {0xc800000000000000ULL, 0x0000000000000000ULL},
+        {0xfa00000000000000ULL, 0x0000000000000000ULL},
+        {0x9c40000000000000ULL, 0x0000000000000000ULL},
+        {0xc350000000000000ULL, 0x0000000000000000ULL},
+        {0xf424000000000000ULL, 0x0000000000000000ULL},
+        {0x9896800000000000ULL, 0x0000000000000000ULL},
+        {0xbebc200000000000ULL, 0x0000000000000000ULL},
+        {0xee6b280000000000ULL, 0x0000000000000000ULL},
+        {0x9502f90000000000ULL, 0x0000000000000000ULL},
+        {0xba43b74000000000ULL, 0x0000000000000000ULL},
+        {0xe8d4a51000000000ULL, 0x0000000000000000ULL},
+        {0x9184e72a00000000ULL, 0x0000000000000000ULL},
+        {0xb5e620f480000000ULL, 0x0000000000000000ULL},
+        {0xe35fa931a0000000ULL, 0x0000000000000000ULL},
+        {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL},
+        {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL},
+        {0xde0b6b3a76400000ULL, 0x0000000000000000ULL},
+        {0x8ac7230489e80000ULL, 0x0000000000000000ULL},
+        {0xad78ebc5ac620000ULL, 0x0000000000000000ULL},
+        {0xd8d726b7177a8000ULL, 0x0000000000000000ULL},
+        {0x878678326eac9000ULL, 0x0000000000000000ULL},
+        {0xa968163f0a57b400ULL, 0x0000000000000000ULL},
+        {0xd3c21bcecceda100ULL, 0x0000000000000000ULL},
+        {0x84595161401484a0ULL, 0x0000000000000000ULL},
+        {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL},
+        {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL},
+        {0x813f3978f8940984ULL, 0x4000000000000000ULL},
+        {0xa18f07d736b90be5ULL, 0x5000000000000000ULL},
+        {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL},
+        {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL},
+        {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL},
+        {0xc5371912364ce305ULL, 0x6c28000000000000ULL},
+        {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL},
+        {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL},
+        {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL},
+        {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL},
+        {0x96769950b50d88f4ULL, 0x1314448000000000ULL},
+        {0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL},
+        {0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL},
+        {0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL},
+        {0xb7abc627050305adULL, 0xf14a3d9e40000000ULL},
+        {0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL},
+        {0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL},
+        {0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL},
+        {0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL},
+        {0x8c213d9da502de45ULL, 0x4526f422cc340000ULL},
+        {0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL},
+        {0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL},
+        {0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL},
+        {0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL},
+        {0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL},
+        {0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL},
+        {0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL},
+        {0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL},
+        {0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL},
+        {0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL},
+        {0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL},
+        {0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL},
+        {0x9f4f2726179a2245ULL, 0x01d762422c946590ULL},
+        {0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL},
+        {0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL},
+        {0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL},
+        {0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL},
+        {0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL},
+        {0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL},
+        {0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL},
+        {0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL},
+        {0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL},
+        {0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL},
+        {0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL},
+        {0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL},
+        {0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL},
+        {0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL},
+        {0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL},
+        {0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL},
+        {0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL},
+        {0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL},
+        {0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL},
+        {0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL},
+        {0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL},
+        {0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL},
+        {0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL},
+        {0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL},
+        {0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL},
+        {0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL},
+        {0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL},
+        {0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL},
+        {0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL},
+        {0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL},
+        {0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL},
+        {0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL},
+        {0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL},
+        {0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL},
+        {0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL},
+        {0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL},
+        {0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL},
+        {0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL},
+        {0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL},
+        {0x924d692ca61be758ULL, 0x593c2626705f9c56ULL},
+        {0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL},
+        {0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL},
+        {0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL},
+        {0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL},
+        {0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL},
+        {0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL},
+        {0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL},
+        {0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL},
+        {0x884134fe908658b2ULL, 0x3109058d147fdcddULL},
+        {0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL},
+        {0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL},
+        {0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL},
+        {0xa6539930bf6bff45ULL, 0x84db8346b786151cULL},
+        {0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL},
+        {0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL},
+        {0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL},
+        {0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL},
+        {0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL},
+        {0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL},
+        {0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL},
+        {0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL},
+        {0x9ae757596946075fULL, 0x3375788de9b06958ULL},
+        {0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL},
+        {0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL},
+        {0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL},
+        {0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL},
+        {0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL},
+        {0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL},
+        {0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL},
+        {0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL},
+        {0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL},
+        {0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL},
+        {0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL},
+        {0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL},
+        {0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL},
+        {0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL},
+        {0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL},
+        {0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL},
+        {0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL},
+        {0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL},
+        {0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL},
+        {0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL},
+        {0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL},
+        {0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL},
+        {0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL},
+        {0x802221226be55a64ULL, 0xc2494954da2c9789ULL},
+        {0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL},
+        {0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL},
+        {0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL},
+        {0x9c69a97284b578d7ULL, 0xff2a760414536efbULL},
+        {0xc38413cf25e2d70dULL, 0xfef5138519684abaULL},
+        {0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL},
+        {0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL},
+        {0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL},
+        {0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL},
+        {0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL},
+        {0xba756174393d88dfULL, 0x94f971119aeef9e4ULL},
+        {0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL},
+        {0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL},
+        {0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL},
+        {0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL},
+        {0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL},
+        {0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL},
+        {0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL},
+        {0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL},
+        {0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL},
+        {0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL},
+        {0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL},
+        {0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL},
+        {0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL},
+        {0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL},
+        {0xa59bc234db398c25ULL, 0x43fab9837e699095ULL},
+        {0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL},
+        {0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL},
+        {0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL},
+        {0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL},
+        {0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL},
+        {0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL},
+        {0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL},
+        {0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL},
+        {0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL},
+        {0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL},
+        {0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL},
+        {0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL},
+        {0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL},
+        {0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL},
+        {0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL},
+        {0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL},
+        {0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL},
+        {0x8fa475791a569d10ULL, 0xf96e017d694487bcULL},
+        {0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL},
+        {0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL},
+        {0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL},
+        {0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL},
+        {0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL},
+        {0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL},
+        {0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL},
+        {0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL},
+        {0x85c7056562757456ULL, 0xf6872d5667844e49ULL},
+        {0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL},
+        {0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL},
+        {0x82a45b450226b39cULL, 0xecc0024661173473ULL},
+        {0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL},
+        {0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL},
+        {0xff290242c83396ceULL, 0x7e67047175a15271ULL},
+        {0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL},
+        {0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL},
+        {0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL},
+        {0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL},
+        {0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL},
+        {0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL},
+        {0x98165af37b2153deULL, 0xc3727a337a8b704aULL},
+        {0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL},
+        {0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL},
+        {0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL},
+        {0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL},
+        {0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL},
+        {0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL},
+        {0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL},
+        {0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL},
+        {0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL},
+        {0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL},
+        {0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL},
+        {0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL},
+        {0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL},
+        {0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL},
+        {0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL},
+        {0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL},
+        {0xd31045a8341ca07cULL, 0x1ede48111209a050ULL},
+        {0x83ea2b892091e44dULL, 0x934aed0aab460432ULL},
+        {0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL},
+        {0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL},
+        {0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL},
+        {0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL},
+        {0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL},
+        {0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL},
+        {0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL},
+        {0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL},
+        {0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL},
+        {0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL},
+        {0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL},
+        {0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL},
+        {0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL},
+        {0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL},
+        {0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL},
+        {0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL},
+        {0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL},
+        {0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL},
+        {0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL},
+        {0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL},
+        {0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL},
+        {0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL},
+        {0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL},
+        {0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL},
+        {0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL},
+        {0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL},
+        {0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL},
+        {0x8533285c936b35deULL, 0xd53a88958f87275fULL},
+        {0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL},
+        {0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL},
+        {0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL},
+        {0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL},
+        {0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL},
+        {0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL},
+        {0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL},
+        {0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL},
+        {0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL},
+        {0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL},
+        {0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL},
+        {0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL},
+        {0x976e41088617ca01ULL, 0xd5be0503e085d813ULL},
+        {0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL},
+        {0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL},
+        {0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL},
+        {0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL},
+        {0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL},
+        {0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL},
+        {0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL},
+        {0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL},
+        {0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL},
+        {0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL},
+        {0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL},
+        {0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL},
+        {0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL},
+        {0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL},
+        {0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL},
+        {0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL},
+        {0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL},
+        {0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL},
+        {0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL},
+        {0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL},
+        {0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL},
+        {0xa0555e361951c366ULL, 0xd7e105bcc332621fULL},
+        {0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL},
+        {0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL},
+        {0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL},
+        {0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL},
+        {0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL},
+        {0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL},
+        {0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL},
+        {0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL},
+        {0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL},
+        {0xbaa718e68396cffdULL, 0xd30560258f54e6baULL},
+        {0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL},
+        {0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL},
+        {0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL},
+        {0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL},
+        {0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL},
+};
+
+/* interpret eight ascii digits at @p as a number */
+JSONP_STATIC uint32_t jsonp_parse_eight_digits(const char *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        word -= 0x3030303030303030ULL;
+        word = (word * 10) + (word >> 8);
+        word = (((word & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32)))
+                + (((word >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32)))) >> 32;
+        return (uint32_t)word;
+#else
+        uint32_t value = 0;
+        for (int i = 0; i < 8; i++)
+                value = value * 10 + (p[i] - '0');
+        return value;
+#endif
+}
+
+JSONP_STATIC uint64_t jsonp_mul64(uint64_t a, uint64_t b, uint64_t *high)
+{
+#if defined(__SIZEOF_INT128__)
+        __uint128_t product = (__uint128_t)a * b;
+        *high = (uint64_t)(product >> 64);
+        return (uint64_t)product;
+#else
+        uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+        uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+        uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+        uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+        uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+        *high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+        return (cross << 32) | (uint32_t)lo_lo;
+#endif
+}
+
+JSONP_STATIC int jsonp_clz64(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanReverse64(&index, x);
+        return 63 - (int)index;
+#else
+        return __builtin_clzll(x);
+#endif
+}
+
+/* compute the double nearest to @mantissa * 10^@exp10 with the
+   Eisel-Lemire algorithm, @mantissa must be non-zero; returns zero
+   when the result can't be decided this way, or would be subnormal,
+   infinite or out of the table's range */
+JSONP_STATIC int jsonp_eisel_lemire(uint64_t mantissa, int exp10, int negative, double *out)
+{
+        if (exp10 < JSONP_POW5_MIN_EXP10 || exp10 > JSONP_POW5_MAX_EXP10)
+                return 0;
+
+        const uint64_t *pow5 = jsonp_pow5_table[exp10 - JSONP_POW5_MIN_EXP10];
+        int lz = jsonp_clz64(mantissa);
+        mantissa <<= lz;
+        uint64_t exp2 = (uint64_t)(((217706 * exp10) >> 16) + 64 + 1023 - lz);
+
+        uint64_t x_hi, x_lo = jsonp_mul64(mantissa, pow5[0], &x_hi);
+
+        /* the truncated product may be off by one in the bits that
+           decide rounding, so bring in the low half of the power */
+        if ((x_hi & 0x1ff) == 0x1ff && x_lo + mantissa < mantissa) {
+                uint64_t y_hi, y_lo = jsonp_mul64(mantissa, pow5[1], &y_hi);
+                uint64_t merged_hi = x_hi, merged_lo = x_lo + y_hi;
+                if (merged_lo < x_lo)
+                        merged_hi++;
+                if ((merged_hi & 0x1ff) == 0x1ff && merged_lo + 1 == 0
+                    && y_lo + mantissa < mantissa)
+                        return 0;
+                x_hi = merged_hi;
+                x_lo = merged_lo;
+        }
+
+        uint64_t msb = x_hi >> 63;
+        uint64_t bits = x_hi >> (msb + 9);
+        exp2 -= 1 ^ msb;
+
+        /* exactly halfway between two doubles */
+        if (x_lo == 0 && (x_hi & 0x1ff) == 0 && (bits & 3) == 1)
+                return 0;
+
+        bits += bits & 1;
+        bits >>= 1;
+        if (bits >> 53) {
+                bits >>= 1;
+                exp2++;
+        }
+
+        if (exp2 - 1 >= 0x7ff - 1)
+                return 0;
+
+        bits = (exp2 << 52) | (bits & 0x000fffffffffffffULL);
+        if (negative)
+                bits |= 0x8000000000000000ULL;
+        memcpy(out, &bits, sizeof(*out));
+        return 1;
+}
+
+/* strtod reads the decimal point of the current locale, so the text
+   is copied and given that decimal point first */
+JSONP_STATIC double jsonp_strtod(const char *p, const char *end)
+{
+        const char *point = localeconv()->decimal_point;
+        size_t point_size = strlen(point);
+        char local[64], *copy = local, *out;
+        size_t size = (end - p) + point_size;
+        double value;
+
+        if (size >= sizeof(local) && (copy = (char *)malloc(size + 1)) == NULL)
+                return 0.0;
+        for (out = copy; p < end; p++) {
+                if (*p == '.') {
+                        memcpy(out, point, point_size);
+                        out += point_size;
+                } else {
+                        *out++ = *p;
+                }
+        }
+        *out = '\0';
+
+        value = strtod(copy, NULL);
+        if (copy != local)
+                free(copy);
+        return value;
+}
+
+/* decode the number at @p, which has already been matched by
+   jsonp_scan_number, into @number */
+JSONP_STATIC void jsonp_decode_number(const char *p, const char *end, jsonp_number_t *number)
+{
+        const char *start = p, *first;
+        uint64_t mantissa = 0;
+        int negative = 0, is_integer = 1, exp10 = 0;
+        size_t digits;
+
+        if (*p == '-') {
+                negative = 1;
+                p++;
+        }
+
+        first = p;
+        while (end - p >= 8 && jsonp_is_eight_digits(p)) {
+                mantissa = mantissa * 100000000 + jsonp_parse_eight_digits(p);
+                p += 8;
+        }
+        while (p < end && *p >= '0' && *p <= '9')
+                mantissa = mantissa * 10 + (*p++ - '0');
+        digits = p - first;
+
+        if (p < end && *p == '.') {
+                const char *fraction = ++p;
+                is_integer = 0;
+                while (end - p >= 8 && jsonp_is_eight_digits(p)) {
+                        mantissa = mantissa * 100000000 + jsonp_parse_eight_digits(p);
+                        p += 8;
+                }
+                while (p < end && *p >= '0' && *p <= '9')
+                        mantissa = mantissa * 10 + (*p++ - '0');
+                exp10 = -(int)(p - fraction);
+                digits += p - fraction;
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+                int exp_negative = 0, exp = 0;
+                is_integer = 0;
+                if (*++p == '-' || *p == '+')
+                        exp_negative = *p++ == '-';
+                /* anything past this is zero or infinity either way */
+                for (; p < end; p++)
+                        if (exp < 100000)
+                                exp = exp * 10 + (*p - '0');
+                exp10 += exp_negative ? -exp : exp;
+        }
+
+        /* leading zeros don't count towards the digits that fit in
+           the mantissa */
+        for (; first < end && (*first == '0' || *first == '.'); first++)
+                if (*first == '0')
+                        digits--;
+
+        if (is_integer && digits <= 20) {
+                /* only 19 digits are certain to fit, a twentieth one
+                   is redone with an overflow check */
+                if (digits == 20) {
+                        mantissa = 0;
+                        for (p = first; p < end - 1; p++)
+                                mantissa = mantissa * 10 + (*p - '0');
+                        if (mantissa > (UINT64_MAX - (*p - '0')) / 10)
+                                goto fallback;
+                        mantissa = mantissa * 10 + (*p - '0');
+                }
+
+                if (negative) {
+                        if (mantissa > (uint64_t)INT64_MAX + 1)
+                                goto fallback;
+                        number->type = JSONP_NUMBER_INT;
+                        number->i = mantissa == 0 ? 0 : -(int64_t)(mantissa - 1) - 1;
+                        number->u = 0;
+                        number->d = -(double)mantissa;
+                } else {
+                        number->type = mantissa > (uint64_t)INT64_MAX
+                                ? JSONP_NUMBER_UINT : JSONP_NUMBER_INT;
+                        number->i = mantissa > (uint64_t)INT64_MAX ? 0 : (int64_t)mantissa;
+                        number->u = mantissa;
+                        number->d = (double)mantissa;
+                }
+                return;
+        }
+
+        number->type = JSONP_NUMBER_DOUBLE;
+        number->i = 0;
+        number->u = 0;
+        if (digits > 19)
+                goto fallback;
+
+        if (mantissa == 0) {
+                number->d = negative ? -0.0 : 0.0;
+                return;
+        }
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+        /* both operands are exact doubles, so a single rounding gives
+           the correctly rounded result */
+        if (mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+                static const double powers[] = {
+                        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+                };
+                double value = (double)mantissa;
+                value = exp10 < 0 ? value / powers[-exp10] : value * powers[exp10];
+                number->d = negative ? -value : value;
+                return;
+        }
+#endif
+
+        if (jsonp_eisel_lemire(mantissa, exp10, negative, &number->d))
+                return;
+fallback:
+        number->type = JSONP_NUMBER_DOUBLE;
+        number->i = 0;
+        number->u = 0;
+        number->d = jsonp_strtod(start, end);
+}
+
+JSONP_STATIC jsonp_token jsonp_number_token(jsonp_lexer_t *lexer)
+{
+        jsonp_begin_capture(lexer);
+        if (lexer->fd) {
+                while (jsonp_is_number_char(lexer->lookahead)) {
+                        jsonp_capture_char(lexer);
+                        lexer->lookahead = jsonp_next_char(lexer);
+                }
+
+                jsonp_view_t view = jsonp_end_capture(lexer);
+                const char *stop;
+                if (!jsonp_scan_number(view.data, view.data + view.size, &stop)
+                    || stop != view.data + view.size)
+                        return jsonp_error_token(lexer, "Invalid number",
+                                                 jsonp_error_position(lexer) - view.size);
+                jsonp_decode_number(view.data, stop, &lexer->tok.number);
+                return jsonp_set_token(lexer, JSONP_TYPE_NUMBER, view.data, view.size);
+        }
+
+        const char *start = lexer->input + lexer->capture_start;
+        const char *end = lexer->input + lexer->input_size;
+        const char *stop;
+        int valid = jsonp_scan_number(start, end, &stop);
+        if (!valid)
+                while (stop < end && jsonp_is_number_char((unsigned char)*stop))
+                        stop++;
+
+        /* a number running into the end of a stream may carry on in
+           the next chunk */
+        if (stop == end && lexer->stream_open)
+                return jsonp_need_more_token(lexer, lexer->capture_start);
+
+        lexer->input_pos = stop - lexer->input;
+        lexer->lookahead = jsonp_next_char(lexer);
+        if (!valid)
+                return jsonp_error_token(lexer, "Invalid number", lexer->capture_start);
+        jsonp_decode_number(start, stop, &lexer->tok.number);
+        return jsonp_set_token(lexer, JSONP_TYPE_NUMBER, start, stop - start);
+}
+
+/* compares the literal at @p with @word, of four or five characters,
+   a word at a time */
+JSONP_STATIC int jsonp_match_literal(const char *p, const char *word, size_t size)
+{
+        uint32_t a, b;
+        memcpy(&a, p, sizeof(a));
+        memcpy(&b, word, sizeof(b));
+        return a == b && (size == 4 || p[4] == word[4]);
+}
+
+JSONP_STATIC jsonp_token jsonp_literal_token(jsonp_lexer_t *lexer, JSONP_TYPE type,
+                                             const char *word, size_t size)
+{
+        if (lexer->fd) {
+                size_t matched = 0;
+                while (matched < size && lexer->lookahead == word[matched]) {
+                        lexer->lookahead = jsonp_next_char(lexer);
+                        matched++;
+                }
+                if (matched == 0)
+                        return jsonp_undefined_token(lexer);
+                if (matched < size || jsonp_is_word_char(lexer->lookahead)) {
+                        lexer->error_offset = jsonp_error_position(lexer) - matched;
+                        return jsonp_set_token(lexer, JSONP_TYPE_UNDEFINED, "UNDEFINED", 9);
+                }
+                return jsonp_set_token(lexer, type, word, size);
+        }
+
+        size_t start = lexer->input_pos - 1;
+        size_t avail = lexer->input_size - start;
+        const char *p = lexer->input + start;
+        if (avail <= size && lexer->stream_open
+            && memcmp(p, word, avail) == 0)
+                return jsonp_need_more_token(lexer, start);
+
+        if (avail >= size && jsonp_match_literal(p, word, size)
+            && (avail == size || !jsonp_is_word_char((unsigned char)p[size]))) {
+                lexer->input_pos = start + size;
+                lexer->lookahead = jsonp_next_char(lexer);
+                return jsonp_set_token(lexer, type, word, size);
+        }
+
+        /* consume as much as matched, as the file path does */
+        size_t matched = 1;
+        lexer->error_offset = start;
+        while (matched < size && matched < avail && p[matched] == word[matched])
+                matched++;
+        lexer->input_pos = start + matched;
+        lexer->lookahead = jsonp_next_char(lexer);
+        return jsonp_set_token(lexer, JSONP_TYPE_UNDEFINED, "UNDEFINED", 9);
+}
+
+JSONP_STATIC jsonp_token jsonp_true_token(jsonp_lexer_t *lexer)
+{
+        return jsonp_literal_token(lexer, JSONP_TYPE_TRUE, "true", 4);
+}
+
+JSONP_STATIC jsonp_token jsonp_false_token(jsonp_lexer_t *lexer)
+{
+        return jsonp_literal_token(lexer, JSONP_TYPE_FALSE, "false", 5);
+}
+
+JSONP_STATIC jsonp_token jsonp_null_token(jsonp_lexer_t *lexer)
+{
+        return jsonp_literal_token(lexer, JSONP_TYPE_NULL, "null", 4);
+}
+
+JSONP_STATIC jsonp_token jsonp_colon_token(jsonp_lexer_t *lexer)
+{
+        jsonp_set_token(lexer, JSONP_TYPE_COLON, ":", 1);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
+}
+
+JSONP_STATIC jsonp_token jsonp_comma_token(jsonp_lexer_t *lexer)
+{
+        jsonp_set_token(lexer, JSONP_TYPE_COMMA, ",", 1);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
+}
+
+JSONP_STATIC jsonp_token jsonp_undefined_token(jsonp_lexer_t *lexer)
+{
+        lexer->error_offset = jsonp_error_position(lexer);
+        jsonp_set_token(lexer, JSONP_TYPE_UNDEFINED, "UNDEFINED", 9);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return lexer->tok;
+}
+
+/* @offset is where in the input the token went wrong */
+JSONP_STATIC jsonp_token jsonp_error_token(jsonp_lexer_t *lexer, const char *msg,
+                                           size_t offset)
+{
+        lexer->error_offset = offset;
+        if (msg == NULL)
+                msg = "Error: no description";
+        return jsonp_set_token(lexer, JSONP_TYPE_ERROR, msg, strlen(msg));
+}
+
+#ifdef JSONP_HAVE_MMAP
+
+JSONP_STATIC int jsonp_map_file(jsonp_lexer_t *lexer, const char *path)
+{
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return JSONP_FILE_ERROR;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+                close(fd);
+                return JSONP_FILE_ERROR;
+        }
+
+        /* an empty file can't be mapped, but lexes as an empty buffer */
+        if (st.st_size > 0) {
+                void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map == MAP_FAILED) {
+                        close(fd);
+                        return JSONP_FILE_ERROR;
+                }
+#ifdef MADV_SEQUENTIAL
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+                lexer->map = map;
+                lexer->map_size = st.st_size;
+        }
+        close(fd);
+
+        lexer->input = lexer->map ? (const char *)lexer->map : "";
+        lexer->input_size = lexer->map_size;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC void jsonp_unmap_file(jsonp_lexer_t *lexer)
+{
+        if (lexer->map) {
+                munmap(lexer->map, lexer->map_size);
+                lexer->map = NULL;
+                lexer->map_size = 0;
+        }
+}
+
+#else /* !defined(JSONP_HAVE_MMAP) */
+
+/* without mmap the file is read into @buffer in one go, which
+   still avoids reading it a character at a time */
+JSONP_STATIC int jsonp_map_file(jsonp_lexer_t *lexer, const char *path)
+{
+        FILE *fd = fopen(path, "rb");
+        if (!fd)
+                return JSONP_FILE_ERROR;
+
+        int status = jsonp_init_buffer(&lexer->buffer);
+        size_t n;
+        while (status == JSONP_NO_BUFFER_ERROR
+               && (n = fread(lexer->buffer.data + lexer->buffer.size, 1,
+                             lexer->buffer.capacity - lexer->buffer.size, fd)) > 0) {
+                lexer->buffer.size += n;
+                if (lexer->buffer.size == lexer->buffer.capacity)
+                        status = jsonp_resize_buffer(&lexer->buffer);
+        }
+        fclose(fd);
+        if (status != JSONP_NO_BUFFER_ERROR)
+                return JSONP_FILE_ERROR;
+
+        lexer->buffer.data[lexer->buffer.size] = '\0';
+        lexer->input = lexer->buffer.data;
+        lexer->input_size = lexer->buffer.size;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC void jsonp_unmap_file(jsonp_lexer_t *lexer)
+{
+        (void)lexer;
+}
+
+#endif /* JSONP_HAVE_MMAP */
+
+JSONP_STATIC const char *jsonp_get_error_init(int status)
+{
+        static const char *msgs[JSONP_ERROR_COUNT] = {
+                "No Error",
+                "File does not exist!",
+                "Could not create buffer!",
+                "Invalid json!",
+                "Field not found!",
+                "More data is needed!",
+        };
+
+        return (status >= 0 && status < JSONP_ERROR_COUNT
+            ? msgs[status] : "Undefined Error!");
+}
+
+JSONP_EXTERN jsonp_info_t jsonp_create_json_info(JSONP_INFO_DATA_TYPE type,
+                                              const char *data)
+{
+        return jsonp_create_json_info_n(type, data, 0);
+}
+
+JSONP_EXTERN jsonp_info_t jsonp_create_json_info_n(JSONP_INFO_DATA_TYPE type,
+                                                   const char *data, size_t size)
+{
+        jsonp_info_t info;
+        if (type < 0 || type >= JSONP_INFO_DATA_COUNT)
+                type = JSONP_TEXT;
+
+        info.type = type;
+        info.data = data;
+        info.size = size;
+        return info;
+}
+
+/* length of the json data described by @info */
+JSONP_STATIC size_t jsonp_info_size(jsonp_info_t info)
+{
+        if (info.size == 0 && info.data != NULL)
+                return strlen(info.data);
+        return info.size;
+}
+
+/* open the input described by @info and prime the lookahead */
+JSONP_STATIC int jsonp_open_input(jsonp_lexer_t *lexer, jsonp_info_t info)
+{
+        switch (info.type) {
+        case JSONP_FILE:
+                lexer->fd = fopen(info.data, "r");
+                if (!lexer->fd) {
+                        jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                        return JSONP_FILE_ERROR;
+                }
+                break;
+        case JSONP_MMAP:
+                if (jsonp_map_file(lexer, info.data) != JSONP_NO_ERROR) {
+                        jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                        return JSONP_FILE_ERROR;
+                }
+                break;
+        case JSONP_STREAM:
+                if (jsonp_init_buffer(&lexer->buffer) != JSONP_NO_BUFFER_ERROR) {
+                        jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                        return JSONP_BUFFER_ERROR;
+                }
+                lexer->input = lexer->buffer.data;
+                lexer->stream_open = 1;
+                jsonp_empty_token(lexer);
+                lexer->lookahead = EOF;
+                if (info.data != NULL)
+                        return jsonp_feed(lexer, info.data, jsonp_info_size(info));
+                return JSONP_NO_ERROR;
+        case JSONP_CACHE:
+                if (jsonp_load_document(&lexer->cache, info.data) != JSONP_NO_ERROR)
+                        return JSONP_FILE_ERROR;
+                lexer->input = "";
+                lexer->cache_next = JSONP_TYPE_EMPTY;
+                break;
+        case JSONP_TEXT_MUTABLE:
+                lexer->in_place = 1;
+                /* fall through */
+        case JSONP_TEXT_BORROWED:
+                lexer->input = info.data ? info.data : "";
+                lexer->input_size = jsonp_info_size(info);
+                break;
+        case JSONP_TEXT:
+        default: /* JSONP_TEXT is also the default case */
+                /* the copy is held in a buffer_t, whose size is an int */
+                if (jsonp_info_size(info) > INT_MAX - 1
+                    || jsonp_init_buffer(&lexer->buffer) != JSONP_NO_BUFFER_ERROR
+                    || jsonp_write_n_buffer(&lexer->buffer, info.data,
+                                            (int)jsonp_info_size(info)) != JSONP_NO_BUFFER_ERROR) {
+                        jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                        return JSONP_BUFFER_ERROR;
+                }
+                lexer->input = lexer->buffer.data;
+                lexer->input_size = lexer->buffer.size;
+                break;
+        }
+
+        jsonp_empty_token(lexer);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_init(jsonp_info_t info)
+{
+        return jsonp_lexer_init(&jsonp_default_lexer, info);
+}
+
+JSONP_EXTERN int jsonp_free(void)
+{
+        return jsonp_lexer_free(&jsonp_default_lexer);
+}
+
+JSONP_EXTERN int jsonp_lexer_init(jsonp_lexer_t *lexer, jsonp_info_t info)
+{
+        return jsonp_lexer_init_arena(lexer, info, NULL);
+}
+
+#ifdef JSONP_STATS
+/* the hooks are shared by every thread, and the totals kept apart */
+JSONP_STATIC jsonp_hooks_t jsonp_hooks;
+JSONP_STATIC JSONP_THREAD_LOCAL jsonp_stats_t jsonp_thread_stats;
+
+/* the lexer's memory is counted on its way to and from the arena */
+JSONP_STATIC void *jsonp_stats_allocator_alloc(void *user, size_t size)
+{
+        jsonp_lexer_t *lexer = (jsonp_lexer_t *)user;
+        lexer->stats.allocations++;
+        return lexer->arena->allocator.alloc(lexer->arena->allocator.user, size);
+}
+
+/* only buffers resize, so each resize is a buffer growing */
+JSONP_STATIC void *jsonp_stats_allocator_resize(void *user, void *ptr,
+                                                size_t old_size, size_t new_size)
+{
+        jsonp_lexer_t *lexer = (jsonp_lexer_t *)user;
+        lexer->stats.buffer_resizes++;
+        return lexer->arena->allocator.resize(lexer->arena->allocator.user, ptr,
+                                              old_size, new_size);
+}
+
+JSONP_STATIC void jsonp_stats_allocator_release(void *user, void *ptr, size_t size)
+{
+        jsonp_lexer_t *lexer = (jsonp_lexer_t *)user;
+        lexer->arena->allocator.release(lexer->arena->allocator.user, ptr, size);
+}
+
+/* fold the counters of @lexer, which is being freed, into the
+   calling thread's totals */
+JSONP_STATIC void jsonp_add_thread_stats(const jsonp_lexer_t *lexer)
+{
+        jsonp_stats_t stats;
+        jsonp_lexer_get_stats(lexer, &stats);
+        jsonp_thread_stats.bytes += stats.bytes;
+        for (int i = 0; i < JSONP_TYPE_COUNT; i++)
+                jsonp_thread_stats.tokens[i] += stats.tokens[i];
+        jsonp_thread_stats.allocations += stats.allocations;
+        jsonp_thread_stats.buffer_resizes += stats.buffer_resizes;
+        jsonp_thread_stats.stack_pushes += stats.stack_pushes;
+        jsonp_thread_stats.stack_pops += stats.stack_pops;
+        jsonp_thread_stats.documents += stats.documents;
+}
+#endif
+
+JSONP_EXTERN int jsonp_lexer_init_arena(jsonp_lexer_t *lexer, jsonp_info_t info,
+                                        jsonp_arena_t *arena)
+{
+        memset(lexer, 0, sizeof(*lexer));
+        lexer->scanner = jsonp_select_scanner();
+        if (arena == NULL) {
+                jsonp_arena_init(&lexer->own_arena, NULL);
+                arena = &lexer->own_arena;
+        }
+        lexer->arena = arena;
+
+        /* every buffer the lexer owns draws on the arena */
+        const jsonp_allocator_t *allocator = &arena->allocator;
+#ifdef JSONP_STATS
+        lexer->stats_allocator.alloc = jsonp_stats_allocator_alloc;
+        lexer->stats_allocator.resize = jsonp_stats_allocator_resize;
+        lexer->stats_allocator.release = jsonp_stats_allocator_release;
+        lexer->stats_allocator.user = lexer;
+        allocator = &lexer->stats_allocator;
+#endif
+        lexer->tok.token.allocator = allocator;
+        lexer->buffer.allocator = allocator;
+        lexer->scratch.allocator = allocator;
+
+        /* a half-opened lexer is cleaned up here, as callers only
+           free lexers that initialised successfully */
+        int status = jsonp_open_input(lexer, info);
+        if (status != JSONP_NO_ERROR)
+                jsonp_lexer_free(lexer);
+        return status;
+}
+
+JSONP_EXTERN int jsonp_lexer_free(jsonp_lexer_t *lexer)
+{
+#ifdef JSONP_STATS
+        jsonp_add_thread_stats(lexer);
+#endif
+        if (lexer->fd) {
+                fclose(lexer->fd);
+                lexer->fd = NULL;
+        }
+
+        jsonp_unmap_file(lexer);
+        jsonp_free_buffer(&lexer->buffer);
+        lexer->input = NULL;
+        lexer->input_size = lexer->input_pos = 0;
+        jsonp_free_buffer(&lexer->scratch);
+        const jsonp_allocator_t *allocator = lexer->tok.token.allocator;
+        jsonp_free_buffer(&lexer->tok.token);
+        for (int i = 0; i < lexer->token_stack_capacity; i++)
+                jsonp_free_buffer(&lexer->token_stack[i].token);
+        if (lexer->token_stack != NULL)
+                jsonp_deallocate(allocator, lexer->token_stack,
+                                 lexer->token_stack_capacity * sizeof(*lexer->token_stack));
+        lexer->token_stack = NULL;
+        lexer->token_stack_size = lexer->token_stack_capacity = 0;
+        if (lexer->cache_stack != NULL)
+                jsonp_deallocate(allocator, lexer->cache_stack,
+                                 lexer->cache_capacity * sizeof(*lexer->cache_stack));
+        lexer->cache_stack = NULL;
+        lexer->cache_depth = lexer->cache_capacity = 0;
+        jsonp_free_document(&lexer->cache);
+
+        if (lexer->arena == &lexer->own_arena)
+                jsonp_arena_free(&lexer->own_arena);
+        lexer->arena = NULL;
+
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_feed(jsonp_lexer_t *lexer, const char *data, size_t size)
+{
+        if (!lexer->stream_open) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+
+        /* drop everything before the lookahead, which is either the
+           start of the next token or of one cut off last time, or
+           before the text of an un-got token that is still in it */
+        size_t keep = jsonp_lookahead_offset(lexer);
+        buffer_t *window = &lexer->buffer;
+        uintptr_t base = (uintptr_t)window->data;
+        for (int i = 0; i < lexer->token_stack_size; i++) {
+                uintptr_t at = (uintptr_t)lexer->token_stack[i].view.data - base;
+                if (at < keep && !jsonp_buffer_holds(&lexer->token_stack[i].token,
+                                                     lexer->token_stack[i].view.data))
+                        keep = at;
+        }
+        memmove(window->data, window->data + keep, window->size - keep);
+        window->size -= keep;
+        lexer->input_pos -= keep;
+        lexer->input_base += keep;
+        JSONP_STAT(lexer->stats.bytes += keep);
+
+        /* the window is a buffer_t, whose size is an int */
+        if (size > (size_t)(INT_MAX - 1 - window->size)
+            || jsonp_append_n_buffer(window, data, (int)size) != JSONP_NO_BUFFER_ERROR) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+
+        /* the text of those tokens has moved along with the window */
+        for (int i = 0; i < lexer->token_stack_size; i++) {
+                jsonp_token *slot = &lexer->token_stack[i];
+                uintptr_t at = (uintptr_t)slot->view.data - base;
+                if (at <= lexer->input_size && !jsonp_buffer_holds(&slot->token, slot->view.data))
+                        slot->view.data = window->data + (at - keep);
+        }
+
+        lexer->input = window->data;
+        lexer->input_size = window->size;
+        if (lexer->lookahead == EOF)
+                lexer->lookahead = jsonp_next_char(lexer);
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_finish(jsonp_lexer_t *lexer)
+{
+        lexer->stream_open = 0;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC const char *jsonp_get_error_buffer(int status)
+{
+        static const char *msgs[JSONP_BUFFER_ERRORS_COUNT] = {
+                "No error",
+                "buffer was null!",
+                "data was null!",
+                "failed to resize buffer!",
+        };
+
+        return (status >= 0 && status < JSONP_BUFFER_ERRORS_COUNT
+                ? msgs[status] : "Unknown Error");
+}
+
+JSONP_EXTERN int jsonp_init_buffer(buffer_t *buffer)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL)
+                buffer->data = (char *)jsonp_allocate(buffer->allocator,
+                                      sizeof(*buffer->data) * (JSONP_BUFFER_CAPACITY + 1));
+
+        if (buffer->data == NULL) {
+                jsonp_free_buffer(buffer);
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        buffer->size = 0;
+        buffer->capacity = JSONP_BUFFER_CAPACITY;
+        return jsonp_clear_buffer(buffer);
+}
+
+JSONP_EXTERN int jsonp_clear_buffer(buffer_t *buffer)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        memset(buffer->data, 0,
+               (buffer->capacity + 1) * sizeof(*buffer->data));
+        buffer->size = 0;
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+JSONP_EXTERN int jsonp_append_buffer(buffer_t *buffer, char c)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        if (buffer->size >= buffer->capacity) {
+                if (jsonp_resize_buffer(buffer) != 0) {
+                        jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
+                        return JSONP_RESIZE_BUFFER_ERROR;
+                }
+        }
+
+        buffer->data[buffer->size++] = c;
+        buffer->data[buffer->size] = '\0';
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+JSONP_EXTERN int jsonp_write_buffer(buffer_t *buffer, const char *data)
+{
+        return jsonp_insert_buffer(buffer, data, 0);
+}
+
+JSONP_EXTERN int jsonp_write_n_buffer(buffer_t *buffer, const char *data, int size)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        if (size < 0) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
+                return JSONP_RESIZE_BUFFER_ERROR;
+        }
+
+        int status;
+        if ((status = jsonp_reserve_buffer(buffer, size)) != JSONP_NO_BUFFER_ERROR)
+                return status;
+
+        if (size > 0)
+                memmove(buffer->data, data, size);
+        buffer->size = size;
+        buffer->data[size] = '\0';
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+JSONP_EXTERN int jsonp_insert_buffer(buffer_t *buffer, const char *data, int offset)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        if (data != NULL) {
+                int data_len = strlen(data) + offset;
+                int status;
+                if ((status = jsonp_reserve_buffer(buffer, data_len))
+                    != JSONP_NO_BUFFER_ERROR)
+                        return status;
+
+                memcpy(buffer->data+offset, data, data_len - offset);
+                buffer->size = data_len;
+                buffer->data[data_len] = '\0';
+        }
+
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+JSONP_EXTERN int jsonp_append_n_buffer(buffer_t *buffer, const char *data, int size)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        if (size < 0 || size > INT_MAX - buffer->size) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
+                return JSONP_RESIZE_BUFFER_ERROR;
+        }
+
+        int status;
+        if ((status = jsonp_reserve_buffer(buffer, buffer->size + size)) != JSONP_NO_BUFFER_ERROR)
+                return status;
+
+        if (size > 0)
+                memcpy(buffer->data + buffer->size, data, size);
+        buffer->size += size;
+        buffer->data[buffer->size] = '\0';
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+JSONP_EXTERN int jsonp_resize_buffer(buffer_t *buffer)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        return jsonp_reserve_buffer(buffer, buffer->capacity * 2);
+}
+
+/* grow @buffer, by doubling, until it can hold @capacity characters,
+   with a single reallocation */
+JSONP_EXTERN int jsonp_reserve_buffer(buffer_t *buffer, int capacity)
+{
+        if (buffer == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
+                return JSONP_NULL_BUFFER_ERROR;
+        }
+
+        if (buffer->data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
+                return JSONP_DATA_BUFFER_ERROR;
+        }
+
+        if (capacity <= buffer->capacity)
+                return JSONP_NO_BUFFER_ERROR;
+        if (capacity < 0 || capacity == INT_MAX) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
+                return JSONP_RESIZE_BUFFER_ERROR;
+        }
+
+        /* doubled in a size_t, so that it can't overflow, and capped so
+           that the capacity and its terminator still fit in an int */
+        size_t new_capacity = buffer->capacity > 0 ? (size_t)buffer->capacity : JSONP_BUFFER_CAPACITY;
+        while (new_capacity < (size_t)capacity)
+                new_capacity *= 2;
+        if (new_capacity > INT_MAX - 1)
+                new_capacity = INT_MAX - 1;
+
+        char *new_data = (char *)jsonp_reallocate(buffer->allocator, buffer->data,
+                                                           buffer->capacity + 1, new_capacity + 1);
+        if (new_data == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
+                return JSONP_RESIZE_BUFFER_ERROR;
+        }
+
+        buffer->data = new_data;
+        buffer->capacity = (int)new_capacity;
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+JSONP_EXTERN int jsonp_free_buffer(buffer_t *buffer)
+{
+        if (buffer != NULL) {
+                if (buffer->data != NULL) {
+                        jsonp_deallocate(buffer->allocator, buffer->data,
+                                         buffer->capacity + 1);
+                        buffer->data = NULL;
+                }
+
+                buffer->size = 0;
+                buffer->capacity = 0;
+        }
+        return JSONP_NO_BUFFER_ERROR;
+}
+
+/* memory handed out by an arena is aligned to this many bytes */
+#define JSONP_ARENA_ALIGNMENT 16
+
+struct jsonp_arena_block {
+        struct jsonp_arena_block *next;
+        size_t size;
+};
+
+/* the block header is padded so that block data stays aligned */
+#define JSONP_ARENA_HEADER_SIZE \
+        ((sizeof(struct jsonp_arena_block) + JSONP_ARENA_ALIGNMENT - 1) \
+         & ~(size_t)(JSONP_ARENA_ALIGNMENT - 1))
+
+JSONP_STATIC char *jsonp_arena_block_data(struct jsonp_arena_block *block)
+{
+        return (char *)block + JSONP_ARENA_HEADER_SIZE;
+}
+
+JSONP_STATIC void *jsonp_arena_allocator_alloc(void *user, size_t size)
+{
+        return jsonp_arena_alloc((jsonp_arena_t *)user, size);
+}
+
+/* the most recent allocation is grown in place when the block has
+   room, anything else is copied to fresh memory; the old copy is
+   only reclaimed when the arena is reset */
+JSONP_STATIC void *jsonp_arena_allocator_resize(void *user, void *ptr,
+                                                size_t old_size, size_t new_size)
+{
+        jsonp_arena_t *arena = (jsonp_arena_t *)user;
+        size_t size = (new_size + JSONP_ARENA_ALIGNMENT - 1) & ~(size_t)(JSONP_ARENA_ALIGNMENT - 1);
+        if (ptr != NULL && ptr == arena->last && arena->current != NULL
+            && (char *)ptr + size <= jsonp_arena_block_data(arena->current)
+                                     + arena->current->size) {
+                arena->offset = (char *)ptr + size
+                        - jsonp_arena_block_data(arena->current);
+                return ptr;
+        }
+
+        void *data = jsonp_arena_alloc(arena, new_size);
+        if (data != NULL && ptr != NULL)
+                memcpy(data, ptr, old_size < new_size ? old_size : new_size);
+        return data;
+}
+
+/* memory is released all at once by jsonp_arena_reset, except that
+   freeing the most recent allocation gives its space straight back */
+JSONP_STATIC void jsonp_arena_allocator_release(void *user, void *ptr, size_t size)
+{
+        jsonp_arena_t *arena = (jsonp_arena_t *)user;
+        (void)size;
+        if (ptr != NULL && ptr == arena->last) {
+                arena->offset = (char *)ptr - jsonp_arena_block_data(arena->current);
+                arena->last = NULL;
+        }
+}
+
+JSONP_EXTERN int jsonp_arena_init(jsonp_arena_t *arena, const jsonp_allocator_t *backing)
+{
+        memset(arena, 0, sizeof(*arena));
+        arena->allocator.alloc = jsonp_arena_allocator_alloc;
+        arena->allocator.resize = jsonp_arena_allocator_resize;
+        arena->allocator.release = jsonp_arena_allocator_release;
+        arena->allocator.user = arena;
+        arena->backing = backing;
+        arena->block_size = JSONP_ARENA_BLOCK_SIZE;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN void *jsonp_arena_alloc(jsonp_arena_t *arena, size_t size)
+{
+        size = (size + JSONP_ARENA_ALIGNMENT - 1) & ~(size_t)(JSONP_ARENA_ALIGNMENT - 1);
+        if (arena->current == NULL || arena->offset + size > arena->current->size) {
+                /* move on to the next block kept from before the last reset,
+                   or chain a new one, sized to fit oversized requests */
+                struct jsonp_arena_block *next = arena->current
+                        ? arena->current->next : arena->head;
+                if (next == NULL || next->size < size) {
+                        size_t block_size = size > arena->block_size ? size : arena->block_size;
+                        struct jsonp_arena_block *block = (struct jsonp_arena_block *)
+                                jsonp_allocate(arena->backing, JSONP_ARENA_HEADER_SIZE + block_size);
+                        if (block == NULL)
+                                return NULL;
+                        block->size = block_size;
+                        block->next = next;
+                        if (arena->current)
+                                arena->current->next = block;
+                        else
+                                arena->head = block;
+                        next = block;
+                }
+                arena->current = next;
+                arena->offset = 0;
+        }
+
+        void *data = jsonp_arena_block_data(arena->current) + arena->offset;
+        arena->offset += size;
+        arena->last = data;
+        return data;
+}
+
+JSONP_EXTERN void jsonp_arena_reset(jsonp_arena_t *arena)
+{
+        arena->current = NULL;
+        arena->offset = 0;
+        arena->last = NULL;
+}
+
+JSONP_EXTERN void jsonp_arena_free(jsonp_arena_t *arena)
+{
+        struct jsonp_arena_block *block = arena->head;
+        while (block != NULL) {
+                struct jsonp_arena_block *next = block->next;
+                jsonp_deallocate(arena->backing, block, JSONP_ARENA_HEADER_SIZE + block->size);
+                block = next;
+        }
+        arena->head = NULL;
+        jsonp_arena_reset(arena);
+}
+
+JSONP_EXTERN JSONP_TYPE jsonp_get_type_token(jsonp_token tok)
+{
+        return tok.type;
+}
+
+JSONP_EXTERN const char *jsonp_get_data_token(jsonp_token tok)
+{
+        /* @view is set in both modes, while @token can be left holding
+           the text of a token that was un-got or peeked before */
+        return tok.view.data;
+}
+
+JSONP_EXTERN size_t jsonp_get_size_token(jsonp_token tok)
+{
+        return tok.view.size;
+}
+
+JSONP_EXTERN jsonp_view_t jsonp_get_view_token(jsonp_token tok)
+{
+        return tok.view;
+}
+
+JSONP_EXTERN jsonp_number_t jsonp_get_number_token(jsonp_token tok)
+{
+        return tok.number;
+}
+
+JSONP_EXTERN int jsonp_is_integer_token(jsonp_token tok)
+{
+        return tok.type == JSONP_TYPE_NUMBER
+                && tok.number.type != JSONP_NUMBER_DOUBLE;
+}
+
+JSONP_EXTERN int64_t jsonp_get_int_token(jsonp_token tok)
+{
+        return tok.number.i;
+}
+
+JSONP_EXTERN uint64_t jsonp_get_uint_token(jsonp_token tok)
+{
+        return tok.number.u;
+}
+
+JSONP_EXTERN double jsonp_get_double_token(jsonp_token tok)
+{
+        return tok.number.d;
+}
+
+JSONP_EXTERN int jsonp_materialize_token(jsonp_token tok, buffer_t *out)
+{
+        int status;
+        if (out != NULL && out->data == NULL
+            && (status = jsonp_init_buffer(out)) != JSONP_NO_BUFFER_ERROR)
+                return status;
+        return jsonp_write_n_buffer(out, tok.view.data, tok.view.size);
+}
+
+JSONP_EXTERN jsonp_token jsonp_peek_token()
+{
+        return jsonp_lexer_peek_token(&jsonp_default_lexer);
+}
+
+JSONP_EXTERN jsonp_token jsonp_get_token()
+{
+        return jsonp_lexer_get_token(&jsonp_default_lexer);
+}
+
+JSONP_EXTERN jsonp_token jsonp_unget_token(jsonp_token tok)
+{
+        return jsonp_lexer_unget_token(&jsonp_default_lexer, tok);
+}
+
+JSONP_EXTERN int jsonp_rewind(void)
+{
+        return jsonp_lexer_rewind(&jsonp_default_lexer);
+}
+
+JSONP_EXTERN jsonp_token jsonp_lexer_peek_token(jsonp_lexer_t *lexer)
+{
+        jsonp_token tok = jsonp_lexer_get_token(lexer);
+        if (tok.type != JSONP_TYPE_NEED_MORE)
+                jsonp_push_token_stack(lexer, tok);
+        return lexer->tok;
+}
+
+JSONP_STATIC jsonp_token jsonp_lex_token(jsonp_lexer_t *lexer);
+JSONP_STATIC jsonp_token jsonp_cache_token(jsonp_lexer_t *lexer);
+
+JSONP_EXTERN jsonp_token jsonp_lexer_get_token(jsonp_lexer_t *lexer)
+{
+        if (!jsonp_empty_token_stack(lexer))
+                return jsonp_pop_token_stack(lexer);
+#ifdef JSONP_STATS
+        jsonp_token tok = jsonp_lex_token(lexer);
+        lexer->stats.tokens[tok.type]++;
+        return tok;
+#else
+        return jsonp_lex_token(lexer);
+#endif
+}
+
+/* lex the next token from the input */
+JSONP_STATIC jsonp_token jsonp_lex_token(jsonp_lexer_t *lexer)
+{
+        if (jsonp_is_whitespace(lexer->lookahead))
+                jsonp_skip_whitespace(lexer);
+
+        switch (lexer->lookahead) {
+        case EOF:
+                /* a cache has no input, its tokens come from its tape */
+                if (lexer->cache.tape != NULL)
+                        return jsonp_cache_token(lexer);
+                if (lexer->stream_open)
+                        return jsonp_set_token(lexer, JSONP_TYPE_NEED_MORE, "", 0);
+                return jsonp_eof_token(lexer);
+        case '{':
+                return jsonp_open_brace_token(lexer);
+        case '}':
+                return jsonp_close_brace_token(lexer);
+        case '[':
+                return jsonp_open_bracket_token(lexer);
+        case ']':
+                return jsonp_close_bracket_token(lexer);
+        case ',':
+                return jsonp_comma_token(lexer);
+        case ':':
+                return jsonp_colon_token(lexer);
+        case '"':
+                return jsonp_string_token(lexer);
+        case 't':
+                return jsonp_true_token(lexer);
+        case 'f':
+                return jsonp_false_token(lexer);
+        case 'n':
+                return jsonp_null_token(lexer);
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+                return jsonp_number_token(lexer);
+        default:
+                return jsonp_undefined_token(lexer);
+        }
+}
+
+JSONP_EXTERN jsonp_token jsonp_lexer_unget_token(jsonp_lexer_t *lexer,
+                                                 jsonp_token tok)
+{
+        jsonp_push_token_stack(lexer, tok);
+        return tok;
+}
+
+JSONP_EXTERN int jsonp_lexer_set_token_mode(jsonp_lexer_t *lexer,
+                                            JSONP_TOKEN_MODE mode)
+{
+        if (mode < 0 || mode >= JSONP_TOKEN_MODE_COUNT)
+                return JSONP_BUFFER_ERROR;
+
+        lexer->token_mode = mode;
+        if (mode == JSONP_TOKEN_VIEW)
+                jsonp_free_buffer(&lexer->tok.token);
+        jsonp_empty_token(lexer);
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_lexer_rewind(jsonp_lexer_t *lexer)
+{
+        int status = 0;
+        if (lexer->rewritten) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, "Input was decoded in place, it can't be rewound");
+                return -1;
+        }
+
+        lexer->input_pos = 0;
+        lexer->token_stack_size = 0;
+        lexer->cache_pos = lexer->cache_depth = 0;
+        lexer->cache_next = JSONP_TYPE_EMPTY;
+        lexer->cache_key = 0;
+        if (lexer->fd)
+                status = fseek(lexer->fd, 0, SEEK_SET);
+        lexer->lookahead = jsonp_next_char(lexer);
+        return status;
+}
+
+JSONP_EXTERN int jsonp_had_error(void)
+{
+        return !jsonp_stack_empty_debug();
+}
+
+JSONP_EXTERN const char *jsonp_get_error(void)
+{
+        return jsonp_pop_error_debug()->message;
+}
+
+JSONP_EXTERN int jsonp_get_error_record(jsonp_error_t *error)
+{
+        int found = !jsonp_stack_empty_debug();
+        *error = *jsonp_pop_error_debug();
+        return found ? JSONP_NO_ERROR : JSONP_NOT_FOUND_ERROR;
+}
+
+JSONP_EXTERN int jsonp_lexer_get_stats(const jsonp_lexer_t *lexer, jsonp_stats_t *stats)
+{
+#ifdef JSONP_STATS
+        /* input held in memory is counted by how far into it the lexer is */
+        *stats = lexer->stats;
+        stats->bytes += lexer->input_pos;
+        return JSONP_NO_ERROR;
+#else
+        (void)lexer;
+        memset(stats, 0, sizeof(*stats));
+        return JSONP_NOT_FOUND_ERROR;
+#endif
+}
+
+JSONP_EXTERN int jsonp_get_thread_stats(jsonp_stats_t *stats)
+{
+#ifdef JSONP_STATS
+        *stats = jsonp_thread_stats;
+        return JSONP_NO_ERROR;
+#else
+        memset(stats, 0, sizeof(*stats));
+        return JSONP_NOT_FOUND_ERROR;
+#endif
+}
+
+JSONP_EXTERN void jsonp_set_hooks(const jsonp_hooks_t *hooks)
+{
+#ifdef JSONP_STATS
+        if (hooks != NULL)
+                jsonp_hooks = *hooks;
+        else
+                memset(&jsonp_hooks, 0, sizeof(jsonp_hooks));
+#else
+        (void)hooks;
+#endif
+}
+
+/* move the lexer to @p within @input */
+JSONP_STATIC void jsonp_seek_input(jsonp_lexer_t *lexer, const char *p)
+{
+        lexer->input_pos = p - lexer->input;
+        lexer->lookahead = jsonp_next_char(lexer);
+}
+
+/* record a syntax error at @offset in the input of @lexer */
+JSONP_STATIC int jsonp_syntax_error(jsonp_lexer_t *lexer, size_t offset, const char *msg)
+{
+        jsonp_error_t *error = jsonp_push_error_debug(JSONP_SYNTAX_ERROR, msg);
+        if (lexer->fd)
+                jsonp_locate_file_error(error, lexer->fd, offset);
+        else
+                jsonp_locate_error(error, lexer->input, lexer->input_size, offset,
+                                   lexer->input_base);
+        return JSONP_SYNTAX_ERROR;
+}
+
+/* record @tok, just read from @lexer, as out of place. error and
+   undefined tokens noted where they went wrong as they were lexed,
+   other tokens are found by stepping back over them from the
+   lookahead, which is just past them */
+JSONP_STATIC int jsonp_token_syntax(jsonp_lexer_t *lexer, jsonp_token tok)
+{
+        size_t end = jsonp_error_position(lexer);
+        switch (tok.type) {
+        case JSONP_TYPE_ERROR:
+                return jsonp_syntax_error(lexer, lexer->error_offset, tok.view.data);
+        case JSONP_TYPE_UNDEFINED:
+                return jsonp_syntax_error(lexer, lexer->error_offset, "Unexpected character");
+        case JSONP_TYPE_EOF:
+                return jsonp_syntax_error(lexer, end, "Unexpected end of json");
+        case JSONP_TYPE_STRING:
+                /* the raw body and closing quote are in @scratch for a file */
+                return jsonp_syntax_error(lexer, lexer->fd ? end - lexer->scratch.size - 1
+                                          : lexer->capture_start, "Unexpected string");
+        case JSONP_TYPE_NUMBER:
+                return jsonp_syntax_error(lexer, lexer->fd ? end - lexer->scratch.size
+                                          : lexer->capture_start, "Unexpected number");
+        default:
+                return jsonp_syntax_error(lexer, end - tok.view.size, "Unexpected token");
+        }
+}
+
+/* the cursor ran into the end of the input partway through, a stream
+   is stepped back to @start, to try again once it has been fed */
+JSONP_STATIC int jsonp_cursor_truncated(jsonp_lexer_t *lexer, size_t start)
+{
+        if (lexer->stream_open) {
+                jsonp_seek_input(lexer, lexer->input + start);
+                return JSONP_NEED_MORE_ERROR;
+        }
+        jsonp_seek_input(lexer, lexer->input + lexer->input_size);
+        return jsonp_syntax_error(lexer, lexer->input_size, "Unexpected end of json");
+}
+
+/* the raw cursor works on data held in memory, and can't see tokens
+   that are waiting on the token stack, or that come from a cache */
+JSONP_STATIC int jsonp_cursor_is_raw(jsonp_lexer_t *lexer)
+{
+        return !lexer->fd && lexer->cache.tape == NULL && jsonp_empty_token_stack(lexer);
+}
+
+/* scalars are stepped over up to whatever could follow them */
+JSONP_STATIC int jsonp_is_delimiter(int c)
+{
+        return jsonp_is_whitespace(c) || c == ',' || c == ':' || c == ']' || c == '}';
+}
+
+JSONP_STATIC int jsonp_skip_raw_value(jsonp_lexer_t *lexer)
+{
+        if (jsonp_is_whitespace(lexer->lookahead))
+                jsonp_skip_whitespace(lexer);
+        size_t start = jsonp_lookahead_offset(lexer);
+        const char *p = lexer->input + start, *end = lexer->input + lexer->input_size;
+        int depth = 0;
+
+        if (p >= end)
+                return jsonp_cursor_truncated(lexer, start);
+
+        switch (*p) {
+        case '"':
+                if ((p = jsonp_skip_string(lexer, p + 1, end)) == NULL)
+                        return jsonp_cursor_truncated(lexer, start);
+                p++;
+                break;
+        case '{':
+        case '[':
+                do {
+                        if ((p = lexer->scanner->scan_structural(p, end)) >= end)
+                                return jsonp_cursor_truncated(lexer, start);
+                        if (*p == '"') {
+                                if ((p = jsonp_skip_string(lexer, p + 1, end)) == NULL)
+                                        return jsonp_cursor_truncated(lexer, start);
+                        } else {
+                                depth += *p == '{' || *p == '[' ? 1 : -1;
+                        }
+                        p++;
+                } while (depth > 0);
+                break;
+        default:
+                if (jsonp_is_delimiter((unsigned char)*p))
+                        return jsonp_syntax_error(lexer, p - lexer->input, "Unexpected character");
+                while (p < end && !jsonp_is_delimiter((unsigned char)*p))
+                        p++;
+                /* a number at the end of a stream may not be finished */
+                if (p == end && lexer->stream_open)
+                        return jsonp_cursor_truncated(lexer, start);
+                break;
+        }
+
+        jsonp_seek_input(lexer, p);
+        return JSONP_NO_ERROR;
+}
+
+/* compare the raw text of a key with @key, only decoding it when it
+   has escapes in it */
+JSONP_STATIC int jsonp_match_key(jsonp_lexer_t *lexer, const char *p, const char *end,
+                                 const char *key, size_t size)
+{
+        jsonp_view_t text;
+        const char *stop;
+        if (memchr(p, '\\', end - p) == NULL)
+                return (size_t)(end - p) == size && memcmp(p, key, size) == 0;
+        if (jsonp_decode_string(lexer, p, end + 1, 0, &stop, &text) != JSONP_STRING_OK)
+                return 0;
+        return text.size == size && memcmp(text.data, key, size) == 0;
+}
+
+JSONP_STATIC int jsonp_find_raw_field(jsonp_lexer_t *lexer, const char *key, size_t size)
+{
+        for (;;) {
+                if (jsonp_is_whitespace(lexer->lookahead))
+                        jsonp_skip_whitespace(lexer);
+                size_t start = jsonp_lookahead_offset(lexer);
+                const char *p = lexer->input + start, *end = lexer->input + lexer->input_size;
+                const char *name;
+                int status;
+
+                if (p >= end)
+                        return jsonp_cursor_truncated(lexer, start);
+                if (*p == '}')
+                        return JSONP_NOT_FOUND_ERROR;
+                if (*p == '{' || *p == ',') {
+                        int first = *p == '{';
+                        if ((p = lexer->scanner->scan_whitespace(p + 1, end)) >= end)
+                                return jsonp_cursor_truncated(lexer, start);
+                        if (first && *p == '}') {
+                                jsonp_seek_input(lexer, p);
+                                return JSONP_NOT_FOUND_ERROR;
+                        }
+                }
+                if (*p != '"')
+                        return jsonp_syntax_error(lexer, p - lexer->input, "Unexpected character");
+
+                name = p + 1;
+                if ((p = jsonp_skip_string(lexer, name, end)) == NULL)
+                        return jsonp_cursor_truncated(lexer, start);
+                int match = jsonp_match_key(lexer, name, p, key, size);
+
+                if ((p = lexer->scanner->scan_whitespace(p + 1, end)) >= end)
+                        return jsonp_cursor_truncated(lexer, start);
+                if (*p != ':')
+                        return jsonp_syntax_error(lexer, p - lexer->input, "Unexpected character");
+                if ((p = lexer->scanner->scan_whitespace(p + 1, end)) >= end)
+                        return jsonp_cursor_truncated(lexer, start);
+
+                jsonp_seek_input(lexer, p);
+                if (match)
+                        return JSONP_NO_ERROR;
+                /* step back to the start of the member, not of its value */
+                if ((status = jsonp_skip_raw_value(lexer)) == JSONP_NEED_MORE_ERROR)
+                        return jsonp_cursor_truncated(lexer, start);
+                if (status != JSONP_NO_ERROR)
+                        return status;
+        }
+}
+
+JSONP_STATIC int jsonp_skip_token_value(jsonp_lexer_t *lexer)
+{
+        int depth = 0;
+        do {
+                jsonp_token tok = jsonp_lexer_get_token(lexer);
+                switch (tok.type) {
+                case JSONP_TYPE_OPEN_BRACE:
+                case JSONP_TYPE_OPEN_BRACKET:
+                        depth++;
+                        break;
+                case JSONP_TYPE_CLOSE_BRACE:
+                case JSONP_TYPE_CLOSE_BRACKET:
+                        if (depth-- == 0)
+                                return jsonp_token_syntax(lexer, tok);
+                        break;
+                case JSONP_TYPE_NEED_MORE:
+                        return JSONP_NEED_MORE_ERROR;
+                case JSONP_TYPE_EOF:
+                case JSONP_TYPE_ERROR:
+                        return jsonp_token_syntax(lexer, tok);
+                case JSONP_TYPE_COMMA:
+                case JSONP_TYPE_COLON:
+                        if (depth == 0)
+                                return jsonp_token_syntax(lexer, tok);
+                        break;
+                default:
+                        break;
+                }
+        } while (depth > 0);
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC int jsonp_find_token_field(jsonp_lexer_t *lexer, const char *key, size_t size)
+{
+        jsonp_token tok = jsonp_lexer_get_token(lexer);
+        int status;
+        for (;;) {
+                if (tok.type == JSONP_TYPE_OPEN_BRACE || tok.type == JSONP_TYPE_COMMA)
+                        tok = jsonp_lexer_get_token(lexer);
+                if (tok.type == JSONP_TYPE_NEED_MORE)
+                        return JSONP_NEED_MORE_ERROR;
+                if (tok.type == JSONP_TYPE_CLOSE_BRACE) {
+                        jsonp_lexer_unget_token(lexer, tok);
+                        return JSONP_NOT_FOUND_ERROR;
+                }
+                if (tok.type != JSONP_TYPE_STRING)
+                        return jsonp_token_syntax(lexer, tok);
+
+                int match = tok.view.size == size && memcmp(tok.view.data, key, size) == 0;
+                tok = jsonp_lexer_get_token(lexer);
+                if (tok.type == JSONP_TYPE_NEED_MORE)
+                        return JSONP_NEED_MORE_ERROR;
+                if (tok.type != JSONP_TYPE_COLON)
+                        return jsonp_token_syntax(lexer, tok);
+                if (match)
+                        return JSONP_NO_ERROR;
+                if ((status = jsonp_skip_token_value(lexer)) != JSONP_NO_ERROR)
+                        return status;
+                tok = jsonp_lexer_get_token(lexer);
+        }
+}
+
+JSONP_EXTERN int jsonp_skip_value(jsonp_lexer_t *lexer)
+{
+        return jsonp_cursor_is_raw(lexer)
+                ? jsonp_skip_raw_value(lexer) : jsonp_skip_token_value(lexer);
+}
+
+JSONP_EXTERN int jsonp_find_field(jsonp_lexer_t *lexer, const char *key)
+{
+        return jsonp_find_field_n(lexer, key, strlen(key));
+}
+
+JSONP_EXTERN int jsonp_find_field_n(jsonp_lexer_t *lexer, const char *key, size_t size)
+{
+        return jsonp_cursor_is_raw(lexer)
+                ? jsonp_find_raw_field(lexer, key, size)
+                : jsonp_find_token_field(lexer, key, size);
+}
+
+JSONP_STATIC int jsonp_add_path_node(jsonp_paths_t *paths, const char *name, size_t size)
+{
+        if (paths->node_count == paths->node_capacity) {
+                int capacity = paths->node_capacity ? paths->node_capacity * 2 : 16;
+                struct jsonp_path_node *nodes = (struct jsonp_path_node *)
+                        realloc(paths->nodes, capacity * sizeof(*nodes));
+                if (nodes == NULL)
+                        return -1;
+                paths->nodes = nodes;
+                paths->node_capacity = capacity;
+        }
+
+        struct jsonp_path_node *node = &paths->nodes[paths->node_count];
+        node->name = paths->names.size;
+        node->size = size;
+        node->child = node->sibling = node->id = -1;
+
+        /* only plain numbers can be array indices, "-" and "01" can't */
+        node->index = -1;
+        if (size > 0 && size < 10 && (name[0] != '0' || size == 1)) {
+                node->index = 0;
+                for (size_t i = 0; i < size && node->index >= 0; i++)
+                        node->index = name[i] >= '0' && name[i] <= '9'
+                                ? node->index * 10 + (name[i] - '0') : -1;
+        }
+
+        if (jsonp_append_n_buffer(&paths->names, name, (int)size) != JSONP_NO_BUFFER_ERROR)
+                return -1;
+        return paths->node_count++;
+}
+
+/* the child of @parent for the step @name, added if there isn't one */
+JSONP_STATIC int jsonp_path_child(jsonp_paths_t *paths, int parent, const char *name, size_t size)
+{
+        int child;
+        for (child = paths->nodes[parent].child; child >= 0; child = paths->nodes[child].sibling) {
+                struct jsonp_path_node *node = &paths->nodes[child];
+                if (node->size == size && memcmp(paths->names.data + node->name, name, size) == 0)
+                        return child;
+        }
+
+        if ((child = jsonp_add_path_node(paths, name, size)) < 0)
+                return -1;
+        paths->nodes[child].sibling = paths->nodes[parent].child;
+        paths->nodes[parent].child = child;
+        return child;
+}
+
+JSONP_EXTERN int jsonp_init_paths(jsonp_paths_t *paths)
+{
+        memset(paths, 0, sizeof(*paths));
+        if (jsonp_init_buffer(&paths->names) != JSONP_NO_BUFFER_ERROR
+            || jsonp_add_path_node(paths, "", 0) < 0) {
+                jsonp_free_paths(paths);
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_add_path(jsonp_paths_t *paths, const char *path)
+{
+        int pointer = path[0] == '/', node = 0;
+        char separator = pointer ? '/' : '.';
+        const char *p = path + pointer;
+        buffer_t step = { NULL, 0, 0, NULL };
+
+        if (jsonp_init_buffer(&step) != JSONP_NO_BUFFER_ERROR)
+                return -1;
+
+        /* an empty path is the whole document */
+        while (*path != '\0') {
+                step.size = 0;
+                for (; *p != '\0' && *p != separator; p++) {
+                        char c = *p;
+                        if (pointer && c == '~') {
+                                if (p[1] != '0' && p[1] != '1') {
+                                        node = -1;
+                                        break;
+                                }
+                                c = *++p == '0' ? '~' : '/';
+                        }
+                        jsonp_append_buffer(&step, c);
+                }
+
+                if (node < 0 || (node = jsonp_path_child(paths, node, step.data, step.size)) < 0)
+                        break;
+                if (*p++ == '\0')
+                        break;
+        }
+
+        jsonp_free_buffer(&step);
+        if (node < 0) {
+                jsonp_push_error_debug(JSONP_SYNTAX_ERROR, "Invalid path");
+                return -1;
+        }
+        if (paths->nodes[node].id < 0)
+                paths->nodes[node].id = paths->path_count++;
+        return paths->nodes[node].id;
+}
+
+JSONP_EXTERN int jsonp_free_paths(jsonp_paths_t *paths)
+{
+        free(paths->nodes);
+        paths->nodes = NULL;
+        paths->node_count = paths->node_capacity = paths->path_count = 0;
+        return jsonp_free_buffer(&paths->names);
+}
+
+/* where the lexer is in its input, to tell, along with the size of
+   the token stack, if a callback read the value it was handed */
+JSONP_STATIC long jsonp_lexer_offset(jsonp_lexer_t *lexer)
+{
+        return lexer->fd ? ftell(lexer->fd) : (long)lexer->input_pos;
+}
+
+/* the first character of the next token, without lexing it */
+JSONP_STATIC int jsonp_peek_char(jsonp_lexer_t *lexer)
+{
+        if (!jsonp_empty_token_stack(lexer))
+                return -1;
+        if (jsonp_is_whitespace(lexer->lookahead))
+                jsonp_skip_whitespace(lexer);
+        return lexer->lookahead;
+}
+
+/* the bracket that the next token is, or 0; a callback may have left
+   tokens un-got, in which case it is peeked at as a token */
+JSONP_STATIC int jsonp_peek_bracket(jsonp_lexer_t *lexer)
+{
+        if (jsonp_empty_token_stack(lexer)) {
+                int c = jsonp_peek_char(lexer);
+                return c == '{' || c == '}' || c == '[' || c == ']' ? c : 0;
+        }
+        switch (jsonp_lexer_peek_token(lexer).type) {
+        case JSONP_TYPE_OPEN_BRACE: return '{';
+        case JSONP_TYPE_CLOSE_BRACE: return '}';
+        case JSONP_TYPE_OPEN_BRACKET: return '[';
+        case JSONP_TYPE_CLOSE_BRACKET: return ']';
+        default: return 0;
+        }
+}
+
+JSONP_STATIC int jsonp_match_path_node(jsonp_lexer_t *lexer, const jsonp_paths_t *paths,
+                                       int current, jsonp_path_callback callback, void *user)
+{
+        const struct jsonp_path_node *node = &paths->nodes[current];
+        int status, child;
+        jsonp_token tok;
+
+        if (node->id >= 0) {
+                long offset = jsonp_lexer_offset(lexer);
+                int pending = lexer->token_stack_size;
+                if ((status = callback(user, node->id, lexer)) != 0)
+                        return status;
+                /* the value was read if the lexer moved on and kept no
+                   more tokens back than before; one that was peeked at
+                   has its first token waiting on the stack */
+                if (jsonp_lexer_offset(lexer) != offset && lexer->token_stack_size <= pending)
+                        return JSONP_NO_ERROR;
+        }
+
+        int c = jsonp_peek_bracket(lexer);
+        if (node->child < 0 || (c != '{' && c != '['))
+                return jsonp_skip_value(lexer);
+
+        tok = jsonp_lexer_get_token(lexer);
+        if (c == '[') {
+                long index = 0;
+                if (jsonp_peek_bracket(lexer) == ']') {
+                        jsonp_lexer_get_token(lexer);
+                        return JSONP_NO_ERROR;
+                }
+                do {
+                        for (child = node->child; child >= 0; child = paths->nodes[child].sibling)
+                                if (paths->nodes[child].index == index)
+                                        break;
+                        status = child >= 0
+                                ? jsonp_match_path_node(lexer, paths, child, callback, user)
+                                : jsonp_skip_value(lexer);
+                        if (status != JSONP_NO_ERROR)
+                                return status;
+                        index++;
+                        tok = jsonp_lexer_get_token(lexer);
+                } while (tok.type == JSONP_TYPE_COMMA);
+                return tok.type == JSONP_TYPE_CLOSE_BRACKET ? JSONP_NO_ERROR : jsonp_token_syntax(lexer, tok);
+        }
+
+        if (jsonp_peek_bracket(lexer) == '}') {
+                jsonp_lexer_get_token(lexer);
+                return JSONP_NO_ERROR;
+        }
+        do {
+                tok = jsonp_lexer_get_token(lexer);
+                if (tok.type != JSONP_TYPE_STRING)
+                        return jsonp_token_syntax(lexer, tok);
+                for (child = node->child; child >= 0; child = paths->nodes[child].sibling) {
+                        const struct jsonp_path_node *next = &paths->nodes[child];
+                        if (next->size == tok.view.size
+                            && memcmp(paths->names.data + next->name, tok.view.data, next->size) == 0)
+                                break;
+                }
+                tok = jsonp_lexer_get_token(lexer);
+                if (tok.type != JSONP_TYPE_COLON)
+                        return jsonp_token_syntax(lexer, tok);
+                status = child >= 0
+                        ? jsonp_match_path_node(lexer, paths, child, callback, user)
+                        : jsonp_skip_value(lexer);
+                if (status != JSONP_NO_ERROR)
+                        return status;
+                tok = jsonp_lexer_get_token(lexer);
+        } while (tok.type == JSONP_TYPE_COMMA);
+        return tok.type == JSONP_TYPE_CLOSE_BRACE ? JSONP_NO_ERROR : jsonp_token_syntax(lexer, tok);
+}
+
+JSONP_EXTERN int jsonp_match_paths(jsonp_lexer_t *lexer, const jsonp_paths_t *paths,
+                                   jsonp_path_callback callback, void *user)
+{
+        return jsonp_match_path_node(lexer, paths, 0, callback, user);
+}
+
+/* compare a key of @size bytes with the name of a field of the same
+   size, a word at a time */
+JSONP_STATIC int jsonp_same_key(const char *name, const char *key, size_t size)
+{
+        uint64_t a, b;
+        while (size >= sizeof(a)) {
+                memcpy(&a, name, sizeof(a));
+                memcpy(&b, key, sizeof(b));
+                if (a != b)
+                        return 0;
+                name += sizeof(a);
+                key += sizeof(a);
+                size -= sizeof(a);
+        }
+        return memcmp(name, key, size) == 0;
+}
+
+/* the field of @schema named @key, looked for from @next on */
+JSONP_STATIC const jsonp_field_t *jsonp_schema_field(const jsonp_schema_t *schema,
+                                                     jsonp_view_t key, int next)
+{
+        for (int i = 0, j = next; i < schema->field_count; i++, j++) {
+                if (j == schema->field_count)
+                        j = 0;
+                const jsonp_field_t *field = &schema->fields[j];
+                if (field->size == key.size && jsonp_same_key(field->name, key.data, key.size))
+                        return field;
+        }
+        return NULL;
+}
+
+/* read the key of the next member, and the colon after it, straight
+   from the input when it is held in memory; a key is only decoded
+   when it has escapes in it */
+JSONP_STATIC int jsonp_decode_key(jsonp_lexer_t *lexer, jsonp_view_t *key)
+{
+        jsonp_token tok;
+        if (jsonp_cursor_is_raw(lexer)) {
+                if (jsonp_is_whitespace(lexer->lookahead))
+                        jsonp_skip_whitespace(lexer);
+                size_t start = jsonp_lookahead_offset(lexer);
+                const char *p = lexer->input + start, *end = lexer->input + lexer->input_size;
+                const char *name = p + 1, *stop;
+                if (p >= end)
+                        return jsonp_cursor_truncated(lexer, start);
+                if (*p != '"')
+                        return jsonp_syntax_error(lexer, start, "Unexpected character");
+                if ((p = jsonp_skip_string(lexer, name, end)) == NULL)
+                        return jsonp_cursor_truncated(lexer, start);
+
+                key->data = name;
+                key->size = p - name;
+                if (memchr(name, '\\', key->size) != NULL
+                    && jsonp_decode_string(lexer, name, p + 1, 0, &stop, key) != JSONP_STRING_OK)
+                        return jsonp_syntax_error(lexer, stop - lexer->input, "Invalid key");
+                jsonp_seek_input(lexer, p + 1);
+        } else {
+                tok = jsonp_lexer_get_token(lexer);
+                if (tok.type != JSONP_TYPE_STRING)
+                        return jsonp_token_syntax(lexer, tok);
+                *key = tok.view;
+        }
+
+        tok = jsonp_lexer_get_token(lexer);
+        return tok.type == JSONP_TYPE_COLON ? JSONP_NO_ERROR : jsonp_token_syntax(lexer, tok);
+}
+
+/* @text stays where it is if that is in input that stays put, and is
+   otherwise copied into the lexer's arena */
+JSONP_STATIC int jsonp_decode_text(jsonp_lexer_t *lexer, jsonp_view_t text, jsonp_view_t *out)
+{
+        if (!lexer->fd && !lexer->stream_open
+            && text.data >= lexer->input && text.data <= lexer->input + lexer->input_size) {
+                *out = text;
+                return JSONP_NO_ERROR;
+        }
+
+        char *copy = (char *)jsonp_arena_alloc(lexer->arena, text.size + 1);
+        if (copy == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+        memcpy(copy, text.data, text.size);
+        copy[text.size] = '\0';
+        out->data = copy;
+        out->size = text.size;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC int jsonp_decode_object(jsonp_lexer_t *lexer, const jsonp_schema_t *schema,
+                                     char *out);
+
+JSONP_STATIC int jsonp_decode_field(jsonp_lexer_t *lexer, const jsonp_field_t *field, char *out)
+{
+        jsonp_token tok = jsonp_lexer_get_token(lexer);
+        void *member = out + field->offset;
+        if (tok.type == JSONP_TYPE_NULL)
+                return JSONP_NO_ERROR;
+
+        switch (field->type) {
+        case JSONP_FIELD_INT:
+                if (tok.type != JSONP_TYPE_NUMBER || tok.number.type != JSONP_NUMBER_INT)
+                        break;
+                memcpy(member, &tok.number.i, sizeof(tok.number.i));
+                return JSONP_NO_ERROR;
+        case JSONP_FIELD_UINT:
+                if (tok.type != JSONP_TYPE_NUMBER || tok.number.type == JSONP_NUMBER_DOUBLE
+                    || (tok.number.type == JSONP_NUMBER_INT && tok.number.i < 0))
+                        break;
+                memcpy(member, &tok.number.u, sizeof(tok.number.u));
+                return JSONP_NO_ERROR;
+        case JSONP_FIELD_DOUBLE:
+                if (tok.type != JSONP_TYPE_NUMBER)
+                        break;
+                memcpy(member, &tok.number.d, sizeof(tok.number.d));
+                return JSONP_NO_ERROR;
+        case JSONP_FIELD_BOOL:
+                if (tok.type != JSONP_TYPE_TRUE && tok.type != JSONP_TYPE_FALSE)
+                        break;
+                *(int *)member = tok.type == JSONP_TYPE_TRUE;
+                return JSONP_NO_ERROR;
+        case JSONP_FIELD_STRING:
+                if (tok.type != JSONP_TYPE_STRING)
+                        break;
+                return jsonp_decode_text(lexer, tok.view, (jsonp_view_t *)member);
+        case JSONP_FIELD_OBJECT:
+                if (tok.type != JSONP_TYPE_OPEN_BRACE)
+                        break;
+                return jsonp_decode_object(lexer, field->schema, (char *)member);
+        default:
+                break;
+        }
+        return jsonp_token_syntax(lexer, tok);
+}
+
+/* the members of an object whose '{' has been read */
+JSONP_STATIC int jsonp_decode_object(jsonp_lexer_t *lexer, const jsonp_schema_t *schema,
+                                     char *out)
+{
+        jsonp_token tok;
+        jsonp_view_t key;
+        int status, next = 0;
+
+        if (jsonp_peek_char(lexer) == '}') {
+                jsonp_lexer_get_token(lexer);
+                return JSONP_NO_ERROR;
+        }
+        do {
+                if ((status = jsonp_decode_key(lexer, &key)) != JSONP_NO_ERROR)
+                        return status;
+                const jsonp_field_t *field = jsonp_schema_field(schema, key, next);
+                if (field != NULL) {
+                        status = jsonp_decode_field(lexer, field, out);
+                        next = (int)(field - schema->fields) + 1;
+                } else {
+                        status = jsonp_skip_value(lexer);
+                }
+                if (status != JSONP_NO_ERROR)
+                        return status;
+                tok = jsonp_lexer_get_token(lexer);
+        } while (tok.type == JSONP_TYPE_COMMA);
+        return tok.type == JSONP_TYPE_CLOSE_BRACE ? JSONP_NO_ERROR : jsonp_token_syntax(lexer, tok);
+}
+
+JSONP_EXTERN int jsonp_decode(jsonp_lexer_t *lexer, const jsonp_schema_t *schema, void *out)
+{
+        /* tokens are only looked at, so none of their text is copied */
+        JSONP_TOKEN_MODE mode = lexer->token_mode;
+        jsonp_token tok;
+        int status;
+
+        lexer->token_mode = JSONP_TOKEN_VIEW;
+        tok = jsonp_lexer_get_token(lexer);
+        status = tok.type == JSONP_TYPE_OPEN_BRACE
+                ? jsonp_decode_object(lexer, schema, (char *)out)
+                : tok.type == JSONP_TYPE_NEED_MORE ? JSONP_NEED_MORE_ERROR
+                : jsonp_token_syntax(lexer, tok);
+        lexer->token_mode = mode;
+        return status;
+}
+
+#define JSONP_TAPE_SHIFT 56
+#define JSONP_TAPE_PAYLOAD ((1ULL << JSONP_TAPE_SHIFT) - 1)
+#define JSONP_TAPE_CAPACITY 1024
+
+JSONP_STATIC int jsonp_tape_tag(const jsonp_document_t *doc, size_t index)
+{
+        return (int)(doc->tape[index] >> JSONP_TAPE_SHIFT);
+}
+
+JSONP_STATIC uint64_t jsonp_tape_payload(const jsonp_document_t *doc, size_t index)
+{
+        return doc->tape[index] & JSONP_TAPE_PAYLOAD;
+}
+
+/* make room for @count more entries on the tape */
+JSONP_STATIC int jsonp_reserve_tape(jsonp_document_t *doc, size_t count)
+{
+        if (doc->tape_size + count <= doc->tape_capacity)
+                return JSONP_NO_ERROR;
+
+        size_t capacity = doc->tape_capacity ? doc->tape_capacity : JSONP_TAPE_CAPACITY;
+        while (capacity < doc->tape_size + count)
+                capacity *= 2;
+
+        uint64_t *tape = doc->tape
+                ? (uint64_t *)jsonp_reallocate(doc->allocator, doc->tape,
+                                               doc->tape_capacity * sizeof(*tape),
+                                               capacity * sizeof(*tape))
+                : (uint64_t *)jsonp_allocate(doc->allocator, capacity * sizeof(*tape));
+        if (tape == NULL)
+                return JSONP_BUFFER_ERROR;
+        doc->tape = tape;
+        doc->tape_capacity = capacity;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC int jsonp_push_tape(jsonp_document_t *doc, int tag, uint64_t payload)
+{
+        if (jsonp_reserve_tape(doc, 1) != JSONP_NO_ERROR)
+                return JSONP_BUFFER_ERROR;
+        doc->tape[doc->tape_size++] = ((uint64_t)tag << JSONP_TAPE_SHIFT) | payload;
+        return JSONP_NO_ERROR;
+}
+
+/* make room for @count more bytes of strings */
+JSONP_STATIC int jsonp_reserve_strings(jsonp_document_t *doc, size_t count)
+{
+        if (count <= doc->strings_capacity - doc->strings_size)
+                return JSONP_NO_ERROR;
+        /* an offset has to fit in the payload of a tape entry */
+        if (count > SIZE_MAX - doc->strings_size
+            || doc->strings_size + count > JSONP_TAPE_PAYLOAD)
+                return JSONP_BUFFER_ERROR;
+
+        size_t size = doc->strings_size + count;
+        size_t capacity = doc->strings_capacity ? doc->strings_capacity : JSONP_TAPE_CAPACITY;
+        while (capacity < size)
+                capacity = capacity > SIZE_MAX / 2 ? size : capacity * 2;
+
+        char *strings = doc->strings
+                ? (char *)jsonp_reallocate(doc->allocator, doc->strings,
+                                           doc->strings_capacity, capacity)
+                : (char *)jsonp_allocate(doc->allocator, capacity);
+        if (strings == NULL)
+                return JSONP_BUFFER_ERROR;
+        doc->strings = strings;
+        doc->strings_capacity = capacity;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC int jsonp_push_string_tape(jsonp_document_t *doc, jsonp_view_t text)
+{
+        uint64_t size = text.size;
+        size_t offset = doc->strings_size;
+        if (text.size > SIZE_MAX - sizeof(size) - 1
+            || jsonp_reserve_strings(doc, sizeof(size) + text.size + 1) != JSONP_NO_ERROR)
+                return JSONP_BUFFER_ERROR;
+        memcpy(doc->strings + offset, &size, sizeof(size));
+        if (text.size > 0)
+                memcpy(doc->strings + offset + sizeof(size), text.data, text.size);
+        doc->strings[offset + sizeof(size) + text.size] = '\0';
+        doc->strings_size += sizeof(size) + text.size + 1;
+        return jsonp_push_tape(doc, '"', offset);
+}
+
+/* the text of the string entry at @index */
+JSONP_STATIC jsonp_view_t jsonp_tape_string(const jsonp_document_t *doc, size_t index)
+{
+        const char *entry = doc->strings + jsonp_tape_payload(doc, index);
+        uint64_t size;
+        jsonp_view_t view;
+        memcpy(&size, entry, sizeof(size));
+        view.data = entry + sizeof(size);
+        view.size = (size_t)size;
+        return view;
+}
+
+JSONP_STATIC int jsonp_push_number_tape(jsonp_document_t *doc, jsonp_number_t number)
+{
+        uint64_t bits;
+        int tag;
+        switch (number.type) {
+        case JSONP_NUMBER_INT:
+                tag = 'l';
+                bits = (uint64_t)number.i;
+                break;
+        case JSONP_NUMBER_UINT:
+                tag = 'u';
+                bits = number.u;
+                break;
+        default:
+                tag = 'd';
+                memcpy(&bits, &number.d, sizeof(bits));
+                break;
+        }
+
+        if (jsonp_reserve_tape(doc, 2) != JSONP_NO_ERROR)
+                return JSONP_BUFFER_ERROR;
+        doc->tape[doc->tape_size++] = (uint64_t)tag << JSONP_TAPE_SHIFT;
+        doc->tape[doc->tape_size++] = bits;
+        return JSONP_NO_ERROR;
+}
+
+/* where a parse that ran out of data picks up again, each of them
+   being a point at which a token is read */
+enum {
+        JSONP_RESUME_VALUE = 0,
+        JSONP_RESUME_FIRST,
+        JSONP_RESUME_NEXT,
+        JSONP_RESUME_KEY,
+        JSONP_RESUME_COLON,
+        JSONP_RESUME_DONE,
+};
+
+/* read the next token into tok, suspending the parse at @at when a
+   stream has run out of data */
+#define JSONP_TAPE_TOKEN(at)                                            \
+        do {                                                            \
+                tok = jsonp_lexer_get_token(lexer);                     \
+                if (tok.type == JSONP_TYPE_NEED_MORE) {                 \
+                        parser->resume = (at);                          \
+                        goto suspend;                                   \
+                }                                                       \
+        } while (0)
+
+/* build the tape of @parser's document from the tokens of its lexer,
+   containers are tracked on an explicit stack of the tape indices of
+   their opening entries, so nesting depth is only limited by memory.
+   when the data runs out the parse is suspended, with the stack kept
+   in @parser, and carries on from the same token when called again */
+JSONP_STATIC int jsonp_parse_tape(jsonp_parser_t *parser)
+{
+        jsonp_lexer_t *lexer = &parser->lexer;
+        jsonp_document_t *doc = parser->doc;
+        size_t *stack = parser->stack, depth = parser->depth, capacity = parser->capacity;
+        int status = JSONP_NO_ERROR;
+        jsonp_token tok;
+
+        switch (parser->resume) {
+        case JSONP_RESUME_FIRST:
+                goto first;
+        case JSONP_RESUME_NEXT:
+                goto next;
+        case JSONP_RESUME_KEY:
+                goto key_token;
+        case JSONP_RESUME_COLON:
+                goto colon;
+        case JSONP_RESUME_DONE:
+                return parser->status;
+        }
+
+value:
+        JSONP_TAPE_TOKEN(JSONP_RESUME_VALUE);
+have_value:
+        switch (tok.type) {
+        case JSONP_TYPE_OPEN_BRACE:
+        case JSONP_TYPE_OPEN_BRACKET:
+                if (depth == capacity) {
+                        size_t grown = capacity ? capacity * 2 : 64;
+                        size_t *p = stack
+                                ? (size_t *)jsonp_reallocate(doc->allocator, stack,
+                                                             capacity * sizeof(*stack),
+                                                             grown * sizeof(*stack))
+                                : (size_t *)jsonp_allocate(doc->allocator, grown * sizeof(*stack));
+                        if (p == NULL) {
+                                status = JSONP_BUFFER_ERROR;
+                                goto done;
+                        }
+                        stack = p;
+                        capacity = grown;
+                }
+                stack[depth++] = doc->tape_size;
+                if ((status = jsonp_push_tape(doc, tok.type == JSONP_TYPE_OPEN_BRACE
+                                              ? '{' : '[', 0)) != JSONP_NO_ERROR)
+                        goto done;
+
+first:
+                JSONP_TAPE_TOKEN(JSONP_RESUME_FIRST);
+                if (tok.type == JSONP_TYPE_CLOSE_BRACE || tok.type == JSONP_TYPE_CLOSE_BRACKET)
+                        goto close;
+                if (jsonp_tape_tag(doc, stack[depth - 1]) == '{')
+                        goto key;
+                goto have_value;
+        case JSONP_TYPE_STRING:
+                status = jsonp_push_string_tape(doc, tok.view);
+                break;
+        case JSONP_TYPE_NUMBER:
+                status = jsonp_push_number_tape(doc, tok.number);
+                break;
+        case JSONP_TYPE_TRUE:
+                status = jsonp_push_tape(doc, 't', 0);
+                break;
+        case JSONP_TYPE_FALSE:
+                status = jsonp_push_tape(doc, 'f', 0);
+                break;
+        case JSONP_TYPE_NULL:
+                status = jsonp_push_tape(doc, 'n', 0);
+                break;
+        default:
+                goto syntax;
+        }
+        if (status != JSONP_NO_ERROR)
+                goto done;
+
+next:
+        JSONP_TAPE_TOKEN(JSONP_RESUME_NEXT);
+        if (depth == 0) {
+                if (tok.type != JSONP_TYPE_EOF)
+                        goto syntax;
+                goto done;
+        }
+
+        if (tok.type == JSONP_TYPE_COMMA) {
+                if (jsonp_tape_tag(doc, stack[depth - 1]) == '[')
+                        goto value;
+                goto key_token;
+        }
+
+close:
+        {
+                size_t open = stack[depth - 1];
+                int tag = jsonp_tape_tag(doc, open);
+                if (tok.type != (tag == '{' ? JSONP_TYPE_CLOSE_BRACE : JSONP_TYPE_CLOSE_BRACKET))
+                        goto syntax;
+                if ((status = jsonp_push_tape(doc, tag == '{' ? '}' : ']', open)) != JSONP_NO_ERROR)
+                        goto done;
+                doc->tape[open] |= doc->tape_size;
+                depth--;
+                goto next;
+        }
+
+key_token:
+        JSONP_TAPE_TOKEN(JSONP_RESUME_KEY);
+key:
+        if (tok.type != JSONP_TYPE_STRING)
+                goto syntax;
+        if ((status = jsonp_push_string_tape(doc, tok.view)) != JSONP_NO_ERROR)
+                goto done;
+colon:
+        JSONP_TAPE_TOKEN(JSONP_RESUME_COLON);
+        if (tok.type != JSONP_TYPE_COLON)
+                goto syntax;
+        goto value;
+
+suspend:
+        parser->stack = stack;
+        parser->depth = depth;
+        parser->capacity = capacity;
+        /* a value that is complete only waits to see what follows it */
+        return parser->resume == JSONP_RESUME_NEXT && depth == 0
+                ? JSONP_NO_ERROR : JSONP_NEED_MORE_ERROR;
+
+syntax:
+        status = jsonp_token_syntax(lexer, tok);
+done:
+        if (stack)
+                jsonp_deallocate(doc->allocator, stack, capacity * sizeof(*stack));
+        parser->stack = NULL;
+        parser->depth = parser->capacity = 0;
+        parser->resume = JSONP_RESUME_DONE;
+        parser->status = status;
+        return status;
+}
+
+/* parse into @doc, the lexer drawing on @arena, and the document on
+   @allocator; the tape starts out with room for @capacity entries, or
+   JSONP_TAPE_CAPACITY when it is 0 */
+JSONP_STATIC int jsonp_parse_document_with(jsonp_document_t *doc, jsonp_info_t info,
+                                           jsonp_arena_t *arena,
+                                           const jsonp_allocator_t *allocator,
+                                           size_t capacity)
+{
+        jsonp_parser_t parser;
+        jsonp_lexer_t *lexer = &parser.lexer;
+        int status;
+
+#ifdef JSONP_STATS
+        jsonp_hooks_t hooks = jsonp_hooks;
+        if (hooks.begin != NULL)
+                hooks.begin(hooks.user, info);
+#endif
+        memset(doc, 0, sizeof(*doc));
+        doc->allocator = allocator;
+        if (capacity > 0
+            && (doc->tape = (uint64_t *)jsonp_allocate(allocator, capacity * sizeof(*doc->tape))))
+                doc->tape_capacity = capacity;
+        memset(&parser, 0, sizeof(parser));
+        parser.doc = doc;
+        if ((status = jsonp_lexer_init_arena(lexer, info, arena)) != JSONP_NO_ERROR) {
+#ifdef JSONP_STATS
+                jsonp_stats_t stats;
+                memset(&stats, 0, sizeof(stats));
+                if (hooks.end != NULL)
+                        hooks.end(hooks.user, info, &stats, status);
+#endif
+                return status;
+        }
+        JSONP_STAT(lexer->stats.documents++);
+
+        /* string tokens are copied onto the document, so there's no
+           need for the lexer to copy them first */
+        jsonp_lexer_set_token_mode(lexer, JSONP_TOKEN_VIEW);
+        /* a stream has no more data to come than it was given */
+        if (lexer->stream_open)
+                jsonp_finish(lexer);
+        status = jsonp_parse_tape(&parser);
+
+#ifdef JSONP_STATS
+        if (hooks.end != NULL) {
+                jsonp_stats_t stats;
+                jsonp_lexer_get_stats(lexer, &stats);
+                hooks.end(hooks.user, info, &stats, status);
+        }
+#endif
+        jsonp_lexer_free(lexer);
+        if (status != JSONP_NO_ERROR)
+                jsonp_free_document(doc);
+        return status;
+}
+
+JSONP_EXTERN int jsonp_parse_document(jsonp_document_t *doc, jsonp_info_t info)
+{
+        /* a saved document is already parsed */
+        if (info.type == JSONP_CACHE)
+                return jsonp_load_document(doc, info.data);
+        return jsonp_parse_document_arena(doc, info, NULL);
+}
+
+JSONP_EXTERN int jsonp_parse_document_arena(jsonp_document_t *doc, jsonp_info_t info,
+                                            jsonp_arena_t *arena)
+{
+        return jsonp_parse_document_with(doc, info, arena, arena ? &arena->allocator : NULL, 0);
+}
+
+JSONP_EXTERN int jsonp_free_document(jsonp_document_t *doc)
+{
+#ifdef JSONP_HAVE_MMAP
+        if (doc->map) {
+                munmap(doc->map, doc->map_size);
+                doc->map = NULL;
+                doc->map_size = 0;
+                doc->tape = NULL;
+                doc->strings = NULL;
+        }
+#endif
+        if (doc->tape)
+                jsonp_deallocate(doc->allocator, doc->tape,
+                                 doc->tape_capacity * sizeof(*doc->tape));
+        if (doc->strings)
+                jsonp_deallocate(doc->allocator, doc->strings, doc->strings_capacity);
+        doc->tape = NULL;
+        doc->tape_size = doc->tape_capacity = 0;
+        doc->strings = NULL;
+        doc->strings_size = doc->strings_capacity = 0;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_parser_init(jsonp_parser_t *parser, jsonp_document_t *doc)
+{
+        int status;
+        memset(parser, 0, sizeof(*parser));
+        memset(doc, 0, sizeof(*doc));
+        parser->doc = doc;
+        parser->status = JSONP_NEED_MORE_ERROR;
+        if ((status = jsonp_lexer_init(&parser->lexer, jsonp_create_json_info_n(JSONP_STREAM, NULL, 0)))
+            != JSONP_NO_ERROR)
+                return status;
+        JSONP_STAT(parser->lexer.stats.documents++);
+
+        jsonp_lexer_set_token_mode(&parser->lexer, JSONP_TOKEN_VIEW);
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_parser_feed(jsonp_parser_t *parser, const char *data, size_t size)
+{
+        int status;
+        if (parser->resume == JSONP_RESUME_DONE)
+                return parser->status;
+        if ((status = jsonp_feed(&parser->lexer, data, size)) != JSONP_NO_ERROR)
+                return status;
+        return parser->status = jsonp_parse_tape(parser);
+}
+
+JSONP_EXTERN int jsonp_parser_finish(jsonp_parser_t *parser)
+{
+        if (parser->resume == JSONP_RESUME_DONE)
+                return parser->status;
+        jsonp_finish(&parser->lexer);
+        return parser->status = jsonp_parse_tape(parser);
+}
+
+JSONP_EXTERN int jsonp_parser_free(jsonp_parser_t *parser)
+{
+        if (parser->stack)
+                jsonp_deallocate(parser->doc->allocator, parser->stack,
+                                 parser->capacity * sizeof(*parser->stack));
+        parser->stack = NULL;
+        parser->depth = parser->capacity = 0;
+        return jsonp_lexer_free(&parser->lexer);
+}
+
+JSONP_STATIC jsonp_value_t jsonp_invalid_value(void)
+{
+        jsonp_value_t value = { NULL, 0 };
+        return value;
+}
+
+JSONP_STATIC jsonp_value_t jsonp_make_value(const jsonp_document_t *doc, size_t index)
+{
+        jsonp_value_t value = { doc, index };
+        return value;
+}
+
+/* the index of the entry after the value at @index */
+JSONP_STATIC size_t jsonp_skip_tape(const jsonp_document_t *doc, size_t index)
+{
+        switch (jsonp_tape_tag(doc, index)) {
+        case '{':
+        case '[':
+                return (size_t)jsonp_tape_payload(doc, index);
+        case 'l':
+        case 'u':
+        case 'd':
+                return index + 2;
+        default:
+                return index + 1;
+        }
+}
+
+JSONP_EXTERN jsonp_value_t jsonp_get_root_document(const jsonp_document_t *doc)
+{
+        return doc->tape_size ? jsonp_make_value(doc, 0) : jsonp_invalid_value();
+}
+
+JSONP_EXTERN JSONP_VALUE_TYPE jsonp_get_type_value(jsonp_value_t value)
+{
+        if (value.doc == NULL)
+                return JSONP_VALUE_INVALID;
+
+        switch (jsonp_tape_tag(value.doc, value.index)) {
+        case '{': return JSONP_VALUE_OBJECT;
+        case '[': return JSONP_VALUE_ARRAY;
+        case '"': return JSONP_VALUE_STRING;
+        case 'l':
+        case 'u':
+        case 'd': return JSONP_VALUE_NUMBER;
+        case 't': return JSONP_VALUE_TRUE;
+        case 'f': return JSONP_VALUE_FALSE;
+        case 'n': return JSONP_VALUE_NULL;
+        default: return JSONP_VALUE_INVALID;
+        }
+}
+
+JSONP_EXTERN jsonp_view_t jsonp_get_string_value(jsonp_value_t value)
+{
+        jsonp_view_t view = { "", 0 };
+        if (jsonp_get_type_value(value) == JSONP_VALUE_STRING)
+                view = jsonp_tape_string(value.doc, value.index);
+        return view;
+}
+
+JSONP_EXTERN jsonp_number_t jsonp_get_number_value(jsonp_value_t value)
+{
+        jsonp_number_t number;
+        memset(&number, 0, sizeof(number));
+        if (jsonp_get_type_value(value) != JSONP_VALUE_NUMBER)
+                return number;
+
+        uint64_t bits = value.doc->tape[value.index + 1];
+        switch (jsonp_tape_tag(value.doc, value.index)) {
+        case 'l':
+                number.type = JSONP_NUMBER_INT;
+                number.i = (int64_t)bits;
+                number.u = number.i < 0 ? 0 : bits;
+                number.d = (double)number.i;
+                break;
+        case 'u':
+                number.type = JSONP_NUMBER_UINT;
+                number.u = bits;
+                number.d = (double)bits;
+                break;
+        default:
+                number.type = JSONP_NUMBER_DOUBLE;
+                memcpy(&number.d, &bits, sizeof(number.d));
+                break;
+        }
+        return number;
+}
+
+JSONP_EXTERN int64_t jsonp_get_int_value(jsonp_value_t value)
+{
+        return jsonp_get_number_value(value).i;
+}
+
+JSONP_EXTERN double jsonp_get_double_value(jsonp_value_t value)
+{
+        return jsonp_get_number_value(value).d;
+}
+
+JSONP_EXTERN jsonp_value_t jsonp_get_field_value(jsonp_value_t object, const char *key)
+{
+        return jsonp_get_field_n_value(object, key, strlen(key));
+}
+
+JSONP_EXTERN jsonp_value_t jsonp_get_field_n_value(jsonp_value_t object,
+                                                   const char *key, size_t size)
+{
+        if (jsonp_get_type_value(object) != JSONP_VALUE_OBJECT)
+                return jsonp_invalid_value();
+
+        jsonp_value_t member;
+        for (member = jsonp_first_value(object); member.doc != NULL;
+             member = jsonp_next_value(jsonp_next_value(member))) {
+                jsonp_view_t name = jsonp_get_string_value(member);
+                if (name.size == size && memcmp(name.data, key, size) == 0)
+                        return jsonp_next_value(member);
+        }
+        return jsonp_invalid_value();
+}
+
+JSONP_EXTERN jsonp_value_t jsonp_get_index_value(jsonp_value_t array, size_t index)
+{
+        if (jsonp_get_type_value(array) != JSONP_VALUE_ARRAY)
+                return jsonp_invalid_value();
+
+        jsonp_value_t element = jsonp_first_value(array);
+        while (index-- && element.doc != NULL)
+                element = jsonp_next_value(element);
+        return element;
+}
+
+JSONP_EXTERN size_t jsonp_get_size_value(jsonp_value_t value)
+{
+        JSONP_VALUE_TYPE type = jsonp_get_type_value(value);
+        if (type == JSONP_VALUE_STRING)
+                return jsonp_get_string_value(value).size;
+        if (type != JSONP_VALUE_OBJECT && type != JSONP_VALUE_ARRAY)
+                return 0;
+
+        size_t size = 0;
+        for (jsonp_value_t v = jsonp_first_value(value); v.doc != NULL; v = jsonp_next_value(v))
+                size++;
+        return type == JSONP_VALUE_OBJECT ? size / 2 : size;
+}
+
+/* the value at @index, unless it is the end of a container */
+JSONP_STATIC jsonp_value_t jsonp_tape_value(const jsonp_document_t *doc, size_t index)
+{
+        int tag = index < doc->tape_size ? jsonp_tape_tag(doc, index) : '}';
+        return tag == '}' || tag == ']' ? jsonp_invalid_value() : jsonp_make_value(doc, index);
+}
+
+JSONP_EXTERN jsonp_value_t jsonp_first_value(jsonp_value_t container)
+{
+        JSONP_VALUE_TYPE type = jsonp_get_type_value(container);
+        if (type != JSONP_VALUE_OBJECT && type != JSONP_VALUE_ARRAY)
+                return jsonp_invalid_value();
+        return jsonp_tape_value(container.doc, container.index + 1);
+}
+
+JSONP_EXTERN jsonp_value_t jsonp_next_value(jsonp_value_t value)
+{
+        if (value.doc == NULL)
+                return jsonp_invalid_value();
+        return jsonp_tape_value(value.doc, jsonp_skip_tape(value.doc, value.index));
+}
+
+/* data is split into chunks of about this size, each parsed on one
+   thread, a chunk is taken to start after the first line break at or
+   past its nominal start */
+#define JSONP_BATCH_CHUNK_SIZE (1024 * 1024)
+#define JSONP_BATCH_MIN_CHUNK_SIZE (64 * 1024)
+
+struct jsonp_batch_record {
+        jsonp_document_t doc;
+        int status;
+};
+
+/* a chunk that has been parsed but not yet handed over, the documents
+   of its records are allocated from @arena:
+             @start is where the chunk was taken to start, and @end is
+                    just past its last record */
+struct jsonp_batch_chunk {
+        size_t start;
+        size_t end;
+        struct jsonp_batch_record *records;
+        size_t count;
+        size_t capacity;
+        jsonp_arena_t arena;
+        int ready;
+};
+
+/* state shared by the threads working on a batch; chunks are taken
+   in order from @next_chunk, and the @window chunks from @next_delivery
+   on may be in flight at once, parked in @slots until their turn:
+             @elements holds the records when they are already split,
+                       in which case @size and @chunk_size count them
+             @delivering is set while a thread hands chunks over
+             @end is the end of the last chunk handed over
+             @status stops the batch when set */
+struct jsonp_batch {
+        const char *input;
+        const jsonp_view_t *elements;
+        size_t size;
+        const struct jsonp_scanner *scanner;
+        size_t chunk_size;
+        size_t chunk_count;
+        size_t next_chunk;
+        size_t next_delivery;
+        size_t record;
+        size_t end;
+        struct jsonp_batch_chunk *slots;
+        size_t window;
+        int delivering;
+        int status;
+        jsonp_record_callback callback;
+        void *user;
+#ifdef JSONP_HAVE_THREADS
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+#endif
+};
+
+#ifdef JSONP_HAVE_THREADS
+#define jsonp_lock_batch(batch) pthread_mutex_lock(&(batch)->lock)
+#define jsonp_unlock_batch(batch) pthread_mutex_unlock(&(batch)->lock)
+#define jsonp_wait_batch(batch) pthread_cond_wait(&(batch)->cond, &(batch)->lock)
+#define jsonp_wake_batch(batch) pthread_cond_broadcast(&(batch)->cond)
+#else
+#define jsonp_lock_batch(batch) ((void)0)
+#define jsonp_unlock_batch(batch) ((void)0)
+#define jsonp_wait_batch(batch) ((void)0)
+#define jsonp_wake_batch(batch) ((void)0)
+#endif
+
+/* the line break that ends the record starting at @p, or @end; line
+   breaks are found with memchr, and strings are stepped over with the
+   string scanner so that one with a line break in it doesn't end the
+   record */
+JSONP_STATIC const char *jsonp_record_end(const struct jsonp_scanner *scanner,
+                                          const char *p, const char *end)
+{
+        const char *line = (const char *)memchr(p, '\n', end - p);
+        if (line == NULL)
+                line = end;
+
+        for (;;) {
+                const char *quote = (const char *)memchr(p, '"', line - p);
+                if (quote == NULL)
+                        return line;
+
+                for (p = quote + 1; ; ) {
+                        p = scanner->scan_string(p, end);
+                        if (p == end)
+                                return end;
+                        if (*p == '"')
+                                break;
+                        p += *p == '\\' && p + 1 < end ? 2 : 1;
+                }
+
+                if (++p > line) {
+                        line = (const char *)memchr(p, '\n', end - p);
+                        if (line == NULL)
+                                line = end;
+                }
+        }
+}
+
+/* parse the @size bytes of @data onto the end of @chunk's records, the
+   lexer draws on @scratch, which is reset afterwards */
+JSONP_STATIC int jsonp_push_record(struct jsonp_batch_chunk *chunk, const char *data, size_t size,
+                                   jsonp_arena_t *scratch)
+{
+        if (chunk->count == chunk->capacity) {
+                size_t capacity = chunk->capacity ? chunk->capacity * 2 : 256;
+                struct jsonp_batch_record *records = (struct jsonp_batch_record *)
+                        realloc(chunk->records, capacity * sizeof(*records));
+                if (records == NULL)
+                        return JSONP_BUFFER_ERROR;
+                chunk->records = records;
+                chunk->capacity = capacity;
+        }
+
+        /* records are mostly small, so the tape is sized to the record
+           rather than to JSONP_TAPE_CAPACITY */
+        struct jsonp_batch_record *record = &chunk->records[chunk->count++];
+        /* a size of 0 would be taken as text to be measured with strlen */
+        if (size == 0) {
+                memset(&record->doc, 0, sizeof(record->doc));
+                jsonp_push_error_debug(JSONP_SYNTAX_ERROR, "Empty record");
+                record->status = JSONP_SYNTAX_ERROR;
+                return JSONP_NO_ERROR;
+        }
+        record->status = jsonp_parse_document_with(
+                &record->doc, jsonp_create_json_info_n(JSONP_TEXT_BORROWED, data, size),
+                scratch, &chunk->arena.allocator, size / 4 + 8);
+        jsonp_arena_reset(scratch);
+        return JSONP_NO_ERROR;
+}
+
+/* parse the records starting from @start up to @limit into @chunk, the
+   lexers draw on @scratch */
+JSONP_STATIC int jsonp_parse_chunk(struct jsonp_batch *batch, struct jsonp_batch_chunk *chunk,
+                                   size_t start, size_t limit, jsonp_arena_t *scratch)
+{
+        chunk->start = start;
+        chunk->count = 0;
+        jsonp_arena_reset(&chunk->arena);
+        if (batch->elements) {
+                for (size_t i = start; i < limit; i++) {
+                        const jsonp_view_t *element = &batch->elements[i];
+                        if (jsonp_push_record(chunk, element->data, element->size, scratch)
+                            != JSONP_NO_ERROR)
+                                return JSONP_BUFFER_ERROR;
+                }
+                chunk->end = limit;
+                return JSONP_NO_ERROR;
+        }
+
+        const char *p = batch->input + start, *end = batch->input + batch->size;
+        while (p < batch->input + limit) {
+                const char *line = jsonp_record_end(batch->scanner, p, end);
+                const char *q = p;
+                while (q < line && jsonp_is_whitespace(*q))
+                        q++;
+
+                if (q < line && jsonp_push_record(chunk, q, line - q, scratch) != JSONP_NO_ERROR)
+                        return JSONP_BUFFER_ERROR;
+                p = line < end ? line + 1 : end;
+        }
+
+        chunk->end = p - batch->input;
+        return JSONP_NO_ERROR;
+}
+
+/* where chunk @k is taken to start, if no line break is in a string */
+JSONP_STATIC size_t jsonp_chunk_start(struct jsonp_batch *batch, size_t k)
+{
+        if (k == 0 || batch->elements)
+                return k * batch->chunk_size;
+        size_t nominal = k * batch->chunk_size - 1;
+        const char *line = (const char *)memchr(batch->input + nominal, '\n', batch->size - nominal);
+        return line ? (size_t)(line - batch->input) + 1 : batch->size;
+}
+
+JSONP_STATIC size_t jsonp_chunk_limit(struct jsonp_batch *batch, size_t k)
+{
+        return k + 1 == batch->chunk_count ? batch->size : (k + 1) * batch->chunk_size;
+}
+
+/* hand over the chunks that are ready, in order, called with the batch
+   locked; the lock is let go while the callback runs. a chunk whose
+   start was wrong, because the line break it was taken to start after
+   was in a string, is parsed again from where the chunk before ended */
+JSONP_STATIC void jsonp_deliver_batch(struct jsonp_batch *batch, jsonp_arena_t *scratch)
+{
+        batch->delivering = 1;
+        while (!batch->status && batch->next_delivery < batch->chunk_count) {
+                size_t k = batch->next_delivery;
+                struct jsonp_batch_chunk *chunk = &batch->slots[k % batch->window];
+                if (!chunk->ready)
+                        break;
+                jsonp_unlock_batch(batch);
+
+                int status = JSONP_NO_ERROR;
+                if (chunk->start != batch->end)
+                        status = jsonp_parse_chunk(batch, chunk, batch->end,
+                                                   jsonp_chunk_limit(batch, k), scratch);
+                for (size_t i = 0; i < chunk->count && status == JSONP_NO_ERROR; i++) {
+                        struct jsonp_batch_record *record = &chunk->records[i];
+                        status = batch->callback(batch->user, batch->record++,
+                                                 &record->doc, record->status);
+                }
+                batch->end = chunk->end;
+
+                jsonp_lock_batch(batch);
+                if (status != JSONP_NO_ERROR)
+                        batch->status = status;
+                chunk->ready = 0;
+                batch->next_delivery++;
+                jsonp_wake_batch(batch);
+        }
+        batch->delivering = 0;
+}
+
+JSONP_STATIC void *jsonp_batch_worker(void *arg)
+{
+        struct jsonp_batch *batch = (struct jsonp_batch *)arg;
+        jsonp_arena_t scratch;
+
+        jsonp_arena_init(&scratch, NULL);
+        jsonp_lock_batch(batch);
+        for (;;) {
+                while (!batch->status && batch->next_chunk < batch->chunk_count
+                       && batch->next_chunk >= batch->next_delivery + batch->window)
+                        jsonp_wait_batch(batch);
+                if (batch->status || batch->next_chunk >= batch->chunk_count)
+                        break;
+
+                size_t k = batch->next_chunk++;
+                struct jsonp_batch_chunk *chunk = &batch->slots[k % batch->window];
+                jsonp_unlock_batch(batch);
+
+                int status = jsonp_parse_chunk(batch, chunk, jsonp_chunk_start(batch, k),
+                                               jsonp_chunk_limit(batch, k), &scratch);
+
+                jsonp_lock_batch(batch);
+                if (status != JSONP_NO_ERROR && !batch->status)
+                        batch->status = status;
+                chunk->ready = 1;
+                if (!batch->delivering)
+                        jsonp_deliver_batch(batch, &scratch);
+        }
+        jsonp_wake_batch(batch);
+        jsonp_unlock_batch(batch);
+        jsonp_arena_free(&scratch);
+        return NULL;
+}
+
+JSONP_STATIC int jsonp_batch_threads(int threads)
+{
+#ifdef JSONP_HAVE_THREADS
+        if (threads <= 0)
+                threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        return threads > 0 ? threads : 1;
+#else
+        (void)threads;
+        return 1;
+#endif
+}
+
+/* run @worker on @threads threads, the calling thread among them, and
+   wait for all of them to return; fewer threads are used if some can't
+   be started */
+JSONP_STATIC void jsonp_run_threads(int threads, void *(* worker)(void *), void *arg)
+{
+#ifdef JSONP_HAVE_THREADS
+        pthread_t *workers = NULL;
+        int started = 0;
+        if (threads > 1
+            && (workers = (pthread_t *)malloc((threads - 1) * sizeof(*workers))) != NULL)
+                while (started < threads - 1
+                       && pthread_create(&workers[started], NULL, worker, arg) == 0)
+                        started++;
+#else
+        (void)threads;
+#endif
+
+        worker(arg);
+
+#ifdef JSONP_HAVE_THREADS
+        for (int i = 0; i < started; i++)
+                pthread_join(workers[i], NULL);
+        free(workers);
+#endif
+}
+
+/* work through @batch, once its input and chunking have been set */
+JSONP_STATIC int jsonp_run_batch(struct jsonp_batch *batch, int threads)
+{
+        batch->window = (size_t)threads * 2;
+        batch->slots = (struct jsonp_batch_chunk *)calloc(batch->window, sizeof(*batch->slots));
+        if (batch->slots == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+        for (size_t i = 0; i < batch->window; i++)
+                jsonp_arena_init(&batch->slots[i].arena, NULL);
+
+#ifdef JSONP_HAVE_THREADS
+        pthread_mutex_init(&batch->lock, NULL);
+        pthread_cond_init(&batch->cond, NULL);
+#endif
+        jsonp_run_threads(threads, jsonp_batch_worker, batch);
+#ifdef JSONP_HAVE_THREADS
+        pthread_cond_destroy(&batch->cond);
+        pthread_mutex_destroy(&batch->lock);
+#endif
+
+        for (size_t i = 0; i < batch->window; i++) {
+                free(batch->slots[i].records);
+                jsonp_arena_free(&batch->slots[i].arena);
+        }
+        free(batch->slots);
+        if (batch->status == JSONP_BUFFER_ERROR)
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+        return batch->status;
+}
+
+JSONP_EXTERN int jsonp_parse_lines(jsonp_info_t info, int threads,
+                                   jsonp_record_callback callback, void *user)
+{
+        struct jsonp_batch batch;
+        jsonp_lexer_t lexer;
+        int status;
+
+        /* the whole of the data is needed up front, so a file is mapped */
+        if (info.type == JSONP_FILE)
+                info.type = JSONP_MMAP;
+        if ((status = jsonp_lexer_init(&lexer, info)) != JSONP_NO_ERROR)
+                return status;
+
+        threads = jsonp_batch_threads(threads);
+        memset(&batch, 0, sizeof(batch));
+        batch.input = lexer.input;
+        batch.size = lexer.input_size;
+        batch.scanner = lexer.scanner;
+        batch.callback = callback;
+        batch.user = user;
+
+        /* small inputs are cut finer, so every thread has work */
+        batch.chunk_size = JSONP_BATCH_CHUNK_SIZE;
+        while (batch.chunk_size > JSONP_BATCH_MIN_CHUNK_SIZE
+               && batch.size / batch.chunk_size < (size_t)threads * 4)
+                batch.chunk_size /= 2;
+        batch.chunk_count = (batch.size + batch.chunk_size - 1) / batch.chunk_size;
+
+        status = jsonp_run_batch(&batch, threads);
+        jsonp_lexer_free(&lexer);
+        return status;
+}
+
+/* structural indexing runs in passes, each over all of the chunks in
+   parallel: the first counts each chunk's quotes, from which whether
+   each chunk starts within a string is worked out in order; the second
+   notes the brackets and commas outside strings, and the change in
+   depth over the chunk; the third, once each chunk's starting depth is
+   known, picks out those that separate the top-level elements */
+#define JSONP_INDEX_CHUNK_SIZE (4 * 1024 * 1024)
+#define JSONP_INDEX_MIN_CHUNK_SIZE (256 * 1024)
+
+/* the state of one chunk of an index being built:
+             @marks holds the offsets from @start of the brackets and
+                    commas outside strings
+             @depth is the change in depth over the chunk, and
+                    @min_depth the lowest it gets relative to the start
+             @separators holds where the top-level elements are split */
+struct jsonp_index_chunk {
+        size_t start;
+        size_t end;
+        int quotes;
+        int in_string;
+        uint32_t *marks;
+        size_t mark_count;
+        size_t mark_capacity;
+        long depth;
+        long min_depth;
+        long start_depth;
+        size_t *separators;
+        size_t separator_count;
+        size_t separator_capacity;
+        int roots;
+        int status;
+};
+
+struct jsonp_index_build {
+        const char *input;
+        const struct jsonp_scanner *scanner;
+        struct jsonp_index_chunk *chunks;
+        size_t chunk_count;
+        void (* pass)(struct jsonp_index_build *build, struct jsonp_index_chunk *chunk);
+        size_t next_chunk;
+#ifdef JSONP_HAVE_THREADS
+        pthread_mutex_t lock;
+#endif
+};
+
+/* whether the character at @pos is escaped, by an odd run of
+   backslashes before it; backslashes are paired up the same way in
+   and out of strings, so this doesn't depend on where strings are */
+JSONP_STATIC int jsonp_is_escaped(const char *input, size_t pos)
+{
+        size_t run = 0;
+        while (run < pos && input[pos - run - 1] == '\\')
+                run++;
+        return run & 1;
+}
+
+JSONP_STATIC void jsonp_count_quotes(struct jsonp_index_build *build, struct jsonp_index_chunk *chunk)
+{
+        const char *p = build->input + chunk->start, *end = build->input + chunk->end;
+        int quotes = 0;
+
+        if (jsonp_is_escaped(build->input, chunk->start))
+                p++;
+        while (p < end) {
+                p = build->scanner->scan_string(p, end);
+                if (p == end)
+                        break;
+                if (*p == '"')
+                        quotes++;
+                p += *p == '\\' ? 2 : 1;
+        }
+        chunk->quotes = quotes & 1;
+}
+
+JSONP_STATIC int jsonp_push_mark(struct jsonp_index_chunk *chunk, size_t offset)
+{
+        if (chunk->mark_count == chunk->mark_capacity) {
+                size_t capacity = chunk->mark_capacity ? chunk->mark_capacity * 2 : 4096;
+                uint32_t *marks = (uint32_t *)realloc(chunk->marks, capacity * sizeof(*marks));
+                if (marks == NULL)
+                        return JSONP_BUFFER_ERROR;
+                chunk->marks = marks;
+                chunk->mark_capacity = capacity;
+        }
+        chunk->marks[chunk->mark_count++] = (uint32_t)offset;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC void jsonp_mark_structurals(struct jsonp_index_build *build, struct jsonp_index_chunk *chunk)
+{
+        const char *base = build->input + chunk->start, *p = base, *end = build->input + chunk->end;
+        int in_string = chunk->in_string;
+        long depth = 0, min_depth = 0;
+
+        if (jsonp_is_escaped(build->input, chunk->start))
+                p++;
+        while (p < end) {
+                if (in_string) {
+                        p = build->scanner->scan_string(p, end);
+                        if (p == end)
+                                break;
+                        if (*p == '"')
+                                in_string = 0;
+                        p += *p == '\\' ? 2 : 1;
+                        continue;
+                }
+
+                switch (*p) {
+                case '"':
+                        in_string = 1;
+                        break;
+                case '\\':
+                        p++;
+                        break;
+                case '{':
+                case '[':
+                        depth++;
+                        chunk->status |= jsonp_push_mark(chunk, p - base);
+                        break;
+                case '}':
+                case ']':
+                        if (--depth < min_depth)
+                                min_depth = depth;
+                        /* fall through */
+                case ',':
+                        chunk->status |= jsonp_push_mark(chunk, p - base);
+                        break;
+                }
+                p++;
+        }
+        chunk->depth = depth;
+        chunk->min_depth = min_depth;
+}
+
+JSONP_STATIC void jsonp_find_separators(struct jsonp_index_build *build, struct jsonp_index_chunk *chunk)
+{
+        long depth = chunk->start_depth;
+
+        for (size_t i = 0; i < chunk->mark_count; i++) {
+                size_t pos = chunk->start + chunk->marks[i];
+                char c = build->input[pos];
+                int separator = 0;
+
+                if (c == '{' || c == '[') {
+                        separator = depth++ == 0;
+                        chunk->roots += separator;
+                } else if (c == '}' || c == ']') {
+                        separator = --depth == 0;
+                } else {
+                        separator = depth == 1;
+                }
+                if (!separator)
+                        continue;
+
+                if (chunk->separator_count == chunk->separator_capacity) {
+                        size_t capacity = chunk->separator_capacity ? chunk->separator_capacity * 2 : 256;
+                        size_t *separators = (size_t *)realloc(chunk->separators,
+                                                               capacity * sizeof(*separators));
+                        if (separators == NULL) {
+                                chunk->status = JSONP_BUFFER_ERROR;
+                                return;
+                        }
+                        chunk->separators = separators;
+                        chunk->separator_capacity = capacity;
+                }
+                chunk->separators[chunk->separator_count++] = pos;
+        }
+
+        /* the marks aren't needed once the separators are known */
+        free(chunk->marks);
+        chunk->marks = NULL;
+        chunk->mark_count = chunk->mark_capacity = 0;
+}
+
+JSONP_STATIC void *jsonp_index_worker(void *arg)
+{
+        struct jsonp_index_build *build = (struct jsonp_index_build *)arg;
+
+        for (;;) {
+#ifdef JSONP_HAVE_THREADS
+                pthread_mutex_lock(&build->lock);
+#endif
+                size_t k = build->next_chunk++;
+#ifdef JSONP_HAVE_THREADS
+                pthread_mutex_unlock(&build->lock);
+#endif
+                if (k >= build->chunk_count)
+                        break;
+                build->pass(build, &build->chunks[k]);
+        }
+        return NULL;
+}
+
+JSONP_STATIC void jsonp_run_index_pass(struct jsonp_index_build *build, int threads,
+                                       void (* pass)(struct jsonp_index_build *,
+                                                     struct jsonp_index_chunk *))
+{
+        build->pass = pass;
+        build->next_chunk = 0;
+        jsonp_run_threads(threads, jsonp_index_worker, build);
+}
+
+JSONP_STATIC int jsonp_push_element(jsonp_index_t *index, const char *p, const char *end,
+                                    size_t *capacity)
+{
+        while (p < end && jsonp_is_whitespace(*p))
+                p++;
+        while (end > p && jsonp_is_whitespace(end[-1]))
+                end--;
+
+        if (index->element_count == *capacity) {
+                size_t grown = *capacity ? *capacity * 2 : 256;
+                jsonp_view_t *elements = (jsonp_view_t *)realloc(index->elements,
+                                                                 grown * sizeof(*elements));
+                if (elements == NULL)
+                        return JSONP_BUFFER_ERROR;
+                index->elements = elements;
+                *capacity = grown;
+        }
+        index->elements[index->element_count].data = p;
+        index->elements[index->element_count].size = end - p;
+        index->element_count++;
+        return JSONP_NO_ERROR;
+}
+
+/* gather the elements from the separators of each chunk, checking that
+   there's a single root array with nothing but whitespace after it */
+JSONP_STATIC int jsonp_collect_elements(jsonp_index_t *index, struct jsonp_index_build *build,
+                                        size_t size)
+{
+        size_t capacity = 0, previous = 0, count = 0;
+        int roots = 0, status = JSONP_NO_ERROR;
+
+        for (size_t k = 0; k < build->chunk_count && status == JSONP_NO_ERROR; k++) {
+                struct jsonp_index_chunk *chunk = &build->chunks[k];
+                roots += chunk->roots;
+                for (size_t i = 0; i < chunk->separator_count && status == JSONP_NO_ERROR; i++) {
+                        size_t pos = chunk->separators[i];
+                        if (count++ > 0)
+                                status = jsonp_push_element(index, build->input + previous + 1,
+                                                            build->input + pos, &capacity);
+                        previous = pos;
+                }
+        }
+        if (status != JSONP_NO_ERROR)
+                return status;
+
+        if (roots != 1 || count < 2 || build->input[previous] != ']')
+                return JSONP_SYNTAX_ERROR;
+        for (size_t i = previous + 1; i < size; i++)
+                if (!jsonp_is_whitespace(build->input[i]))
+                        return JSONP_SYNTAX_ERROR;
+
+        /* "[ ]" holds no elements rather than an empty one, any other
+           empty element, as in "[1,,2]" or "[1,]", is missing a value */
+        if (count == 2 && index->elements[0].size == 0)
+                index->element_count = 0;
+        for (size_t i = 0; i < index->element_count; i++)
+                if (index->elements[i].size == 0)
+                        return JSONP_SYNTAX_ERROR;
+        return JSONP_NO_ERROR;
+}
+
+JSONP_STATIC int jsonp_index_document(jsonp_index_t *index, int threads)
+{
+        struct jsonp_index_build build;
+        const char *input = index->lexer.input;
+        size_t size = index->lexer.input_size, chunk_size = JSONP_INDEX_CHUNK_SIZE;
+        int status = JSONP_NO_ERROR, in_string = 0;
+        long depth = 0;
+
+        /* a document that isn't an array is a single element */
+        size_t first = 0;
+        while (first < size && jsonp_is_whitespace(input[first]))
+                first++;
+        if (first == size)
+                return JSONP_SYNTAX_ERROR;
+        if (input[first] != '[') {
+                size_t capacity = 0;
+                if (jsonp_push_element(index, input, input + size, &capacity) != JSONP_NO_ERROR)
+                        return JSONP_BUFFER_ERROR;
+                return JSONP_NO_ERROR;
+        }
+
+        while (chunk_size > JSONP_INDEX_MIN_CHUNK_SIZE && size / chunk_size < (size_t)threads * 4)
+                chunk_size /= 2;
+        memset(&build, 0, sizeof(build));
+        build.input = input;
+        build.scanner = index->lexer.scanner;
+        build.chunk_count = (size + chunk_size - 1) / chunk_size;
+        build.chunks = (struct jsonp_index_chunk *)calloc(build.chunk_count, sizeof(*build.chunks));
+        if (build.chunks == NULL)
+                return JSONP_BUFFER_ERROR;
+        for (size_t k = 0; k < build.chunk_count; k++) {
+                build.chunks[k].start = k * chunk_size;
+                build.chunks[k].end = k + 1 == build.chunk_count ? size : (k + 1) * chunk_size;
+        }
+
+#ifdef JSONP_HAVE_THREADS
+        pthread_mutex_init(&build.lock, NULL);
+#endif
+        jsonp_run_index_pass(&build, threads, jsonp_count_quotes);
+        for (size_t k = 0; k < build.chunk_count; k++) {
+                build.chunks[k].in_string = in_string;
+                in_string ^= build.chunks[k].quotes;
+        }
+
+        jsonp_run_index_pass(&build, threads, jsonp_mark_structurals);
+        for (size_t k = 0; k < build.chunk_count && status == JSONP_NO_ERROR; k++) {
+                struct jsonp_index_chunk *chunk = &build.chunks[k];
+                if (chunk->status != JSONP_NO_ERROR)
+                        status = JSONP_BUFFER_ERROR;
+                else if (depth + chunk->min_depth < 0)
+                        status = JSONP_SYNTAX_ERROR;
+                chunk->start_depth = depth;
+                depth += chunk->depth;
+        }
+        if (status == JSONP_NO_ERROR && (depth != 0 || in_string))
+                status = JSONP_SYNTAX_ERROR;
+
+        if (status == JSONP_NO_ERROR) {
+                jsonp_run_index_pass(&build, threads, jsonp_find_separators);
+                for (size_t k = 0; k < build.chunk_count; k++)
+                        if (build.chunks[k].status != JSONP_NO_ERROR)
+                                status = JSONP_BUFFER_ERROR;
+        }
+        if (status == JSONP_NO_ERROR)
+                status = jsonp_collect_elements(index, &build, size);
+#ifdef JSONP_HAVE_THREADS
+        pthread_mutex_destroy(&build.lock);
+#endif
+
+        for (size_t k = 0; k < build.chunk_count; k++) {
+                free(build.chunks[k].marks);
+                free(build.chunks[k].separators);
+        }
+        free(build.chunks);
+        return status;
+}
+
+JSONP_EXTERN int jsonp_build_index(jsonp_index_t *index, jsonp_info_t info, int threads)
+{
+        int status;
+
+        memset(index, 0, sizeof(*index));
+        if (info.type == JSONP_FILE)
+                info.type = JSONP_MMAP;
+        if ((status = jsonp_lexer_init(&index->lexer, info)) != JSONP_NO_ERROR)
+                return status;
+
+        status = jsonp_index_document(index, jsonp_batch_threads(threads));
+        if (status != JSONP_NO_ERROR) {
+                jsonp_push_error_debug(status, NULL);
+                jsonp_free_index(index);
+        }
+        return status;
+}
+
+JSONP_EXTERN int jsonp_free_index(jsonp_index_t *index)
+{
+        free(index->elements);
+        index->elements = NULL;
+        index->element_count = 0;
+        return jsonp_lexer_free(&index->lexer);
+}
+
+JSONP_EXTERN int jsonp_parse_elements(const jsonp_index_t *index, int threads,
+                                      jsonp_record_callback callback, void *user)
+{
+        struct jsonp_batch batch;
+
+        threads = jsonp_batch_threads(threads);
+        memset(&batch, 0, sizeof(batch));
+        batch.elements = index->elements;
+        batch.size = index->element_count;
+        batch.callback = callback;
+        batch.user = user;
+
+        /* chunks are counted in elements, a few per thread */
+        batch.chunk_size = batch.size / ((size_t)threads * 16);
+        if (batch.chunk_size < 1)
+                batch.chunk_size = 1;
+        if (batch.chunk_size > 4096)
+                batch.chunk_size = 4096;
+        batch.chunk_count = (batch.size + batch.chunk_size - 1) / batch.chunk_size;
+        return jsonp_run_batch(&batch, threads);
+}
+
+
+JSONP_STATIC int jsonp_fwrite_flush(void *user, const char *data, size_t size)
+{
+        return fwrite(data, 1, size, (FILE *)user) != size;
+}
+
+JSONP_EXTERN int jsonp_init_writer(jsonp_writer_t *writer, int indent)
+{
+        return jsonp_init_writer_flush(writer, indent, NULL, NULL);
+}
+
+JSONP_EXTERN int jsonp_init_writer_flush(jsonp_writer_t *writer, int indent,
+                                         jsonp_flush_callback flush, void *user)
+{
+        memset(writer, 0, sizeof(*writer));
+        writer->flush = flush;
+        writer->user = user;
+        writer->scanner = jsonp_select_scanner();
+        writer->indent = indent > 0 ? indent : 0;
+        writer->first = 1;
+        if (jsonp_init_buffer(&writer->out) != JSONP_NO_BUFFER_ERROR) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return writer->status = JSONP_BUFFER_ERROR;
+        }
+        return JSONP_NO_ERROR;
+}
+
+JSONP_EXTERN int jsonp_init_writer_file(jsonp_writer_t *writer, int indent, FILE *fd)
+{
+        return jsonp_init_writer_flush(writer, indent, jsonp_fwrite_flush, fd);
+}
+
+JSONP_EXTERN int jsonp_flush_writer(jsonp_writer_t *writer)
+{
+        if (writer->flush != NULL && writer->out.size > 0 && writer->status == JSONP_NO_ERROR) {
+                if (writer->flush(writer->user, writer->out.data, writer->out.size) != 0) {
+                        jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                        writer->status = JSONP_FILE_ERROR;
+                }
+                writer->out.size = 0;
         }
+        return writer->status;
+}
 
-        if (buffer->data == NULL)
-                buffer->data = (typeof(buffer->data))malloc(sizeof(*buffer->data)
-                                      * (JSONP_BUFFER_CAPACITY + 1));
+JSONP_EXTERN int jsonp_free_writer(jsonp_writer_t *writer)
+{
+        int status = jsonp_flush_writer(writer);
+        jsonp_free_buffer(&writer->out);
+        return status;
+}
 
-        if (buffer->data == NULL) {
-                jsonp_free_buffer(buffer);
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
-                return JSONP_DATA_BUFFER_ERROR;
+/* room for @size more bytes of output, or NULL, the bytes are counted
+   into the output by jsonp_commit_writer */
+JSONP_STATIC char *jsonp_reserve_writer(jsonp_writer_t *writer, size_t size)
+{
+        if (writer->status != JSONP_NO_ERROR)
+                return NULL;
+        /* the output is a buffer_t, whose size is an int */
+        if (size > (size_t)(INT_MAX - 1 - writer->out.size)) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
+                writer->status = JSONP_BUFFER_ERROR;
+                return NULL;
+        }
+        if ((size_t)writer->out.size + size > (size_t)writer->out.capacity
+            && jsonp_reserve_buffer(&writer->out, writer->out.size + (int)size)
+               != JSONP_NO_BUFFER_ERROR) {
+                writer->status = JSONP_BUFFER_ERROR;
+                return NULL;
         }
+        return writer->out.data + writer->out.size;
+}
 
-        buffer->size = 0;
-        buffer->capacity = JSONP_BUFFER_CAPACITY;
-        return jsonp_clear_buffer(buffer);
+/* count the output up to @end in, and flush it if enough has built up */
+JSONP_STATIC int jsonp_commit_writer(jsonp_writer_t *writer, char *end)
+{
+        writer->out.size = (int)(end - writer->out.data);
+        if (writer->flush != NULL && writer->out.size >= JSONP_WRITER_FLUSH_SIZE)
+                return jsonp_flush_writer(writer);
+        return writer->status;
 }
 
-JSONP_EXTERN int jsonp_clear_buffer(buffer_t *buffer)
+/* a line break and the indentation for @depth, when not compact */
+JSONP_STATIC char *jsonp_write_indent(jsonp_writer_t *writer, char *p, int depth)
 {
-        if (buffer == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
-                return JSONP_NULL_BUFFER_ERROR;
+        if (writer->indent > 0) {
+                *p++ = '\n';
+                memset(p, ' ', (size_t)writer->indent * depth);
+                p += (size_t)writer->indent * depth;
         }
+        return p;
+}
 
-        if (buffer->data == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
-                return JSONP_DATA_BUFFER_ERROR;
+/* reserve room for a value of up to @size bytes, after writing the
+   separator that comes before it */
+JSONP_STATIC char *jsonp_begin_value(jsonp_writer_t *writer, size_t size)
+{
+        char *p = jsonp_reserve_writer(writer, size + 2 + (size_t)writer->indent * writer->depth);
+        if (p == NULL || writer->after_key) {
+                writer->after_key = 0;
+                return p;
         }
+        if (writer->depth > 0) {
+                if (!writer->first)
+                        *p++ = ',';
+                p = jsonp_write_indent(writer, p, writer->depth);
+        } else if (!writer->first) {
+                /* values at the top level go one per line */
+                *p++ = '\n';
+        }
+        writer->first = 0;
+        return p;
+}
 
-        memset(buffer->data, 0,
-               (buffer->capacity + 1) * sizeof(*buffer->data));
-        buffer->size = 0;
-        return JSONP_NO_BUFFER_ERROR;
+JSONP_STATIC int jsonp_write_literal(jsonp_writer_t *writer, const char *text, size_t size)
+{
+        char *p = jsonp_begin_value(writer, size);
+        if (p == NULL)
+                return writer->status;
+        memcpy(p, text, size);
+        return jsonp_commit_writer(writer, p + size);
 }
 
-JSONP_EXTERN int jsonp_append_buffer(buffer_t *buffer, char c)
+JSONP_STATIC int jsonp_begin_container_writer(jsonp_writer_t *writer, char c)
 {
-        if (buffer == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
-                return JSONP_NULL_BUFFER_ERROR;
-        }
+        char *p = jsonp_begin_value(writer, 1);
+        if (p == NULL)
+                return writer->status;
+        *p++ = c;
+        writer->depth++;
+        writer->first = 1;
+        return jsonp_commit_writer(writer, p);
+}
 
-        if (buffer->data == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
-                return JSONP_DATA_BUFFER_ERROR;
+JSONP_STATIC int jsonp_end_container_writer(jsonp_writer_t *writer, char c)
+{
+        char *p = jsonp_reserve_writer(writer, 2 + (size_t)writer->indent * writer->depth);
+        if (p == NULL)
+                return writer->status;
+        if (writer->depth == 0) {
+                jsonp_push_error_debug(JSONP_SYNTAX_ERROR, NULL);
+                return writer->status = JSONP_SYNTAX_ERROR;
         }
+        writer->depth--;
+        if (!writer->first)
+                p = jsonp_write_indent(writer, p, writer->depth);
+        *p++ = c;
+        writer->first = 0;
+        return jsonp_commit_writer(writer, p);
+}
 
-        if (buffer->size >= buffer->capacity) {
-                if (jsonp_resize_buffer(buffer) != 0) {
-                        jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
-                        return JSONP_RESIZE_BUFFER_ERROR;
+JSONP_EXTERN int jsonp_begin_object_writer(jsonp_writer_t *writer)
+{
+        return jsonp_begin_container_writer(writer, '{');
+}
+
+JSONP_EXTERN int jsonp_end_object_writer(jsonp_writer_t *writer)
+{
+        return jsonp_end_container_writer(writer, '}');
+}
+
+JSONP_EXTERN int jsonp_begin_array_writer(jsonp_writer_t *writer)
+{
+        return jsonp_begin_container_writer(writer, '[');
+}
+
+JSONP_EXTERN int jsonp_end_array_writer(jsonp_writer_t *writer)
+{
+        return jsonp_end_container_writer(writer, ']');
+}
+
+/* write @size bytes of @data as a quoted string, after @p; runs that
+   need no escaping are found with the string scanner and copied whole,
+   room is made for the worst case, where every byte is escaped */
+JSONP_STATIC char *jsonp_write_quoted(jsonp_writer_t *writer, char *p, const char *data, size_t size)
+{
+        static const char hex[] = "0123456789abcdef";
+        const char *end = data + size;
+
+        *p++ = '"';
+        while (data < end) {
+                const char *run = writer->scanner->scan_string(data, end);
+                memcpy(p, data, run - data);
+                p += run - data;
+                if (run == end)
+                        break;
+
+                unsigned char c = (unsigned char)*run;
+                data = run + 1;
+                if (c >= 0x80) {
+                        *p++ = (char)c;
+                        continue;
+                }
+
+                *p++ = '\\';
+                switch (c) {
+                case '"': *p++ = '"'; break;
+                case '\\': *p++ = '\\'; break;
+                case '\b': *p++ = 'b'; break;
+                case '\f': *p++ = 'f'; break;
+                case '\n': *p++ = 'n'; break;
+                case '\r': *p++ = 'r'; break;
+                case '\t': *p++ = 't'; break;
+                default:
+                        *p++ = 'u';
+                        *p++ = '0';
+                        *p++ = '0';
+                        *p++ = hex[c >> 4];
+                        *p++ = hex[c & 0xf];
+                        break;
                 }
         }
+        *p++ = '"';
+        return p;
+}
 
-        buffer->data[buffer->size++] = c;
-        buffer->data[buffer->size] = '\0';
-        return JSONP_NO_BUFFER_ERROR;
+JSONP_EXTERN int jsonp_key_writer(jsonp_writer_t *writer, const char *key)
+{
+        return jsonp_key_n_writer(writer, key, strlen(key));
 }
 
-JSONP_EXTERN int jsonp_write_buffer(buffer_t *buffer, const char *data)
+JSONP_EXTERN int jsonp_key_n_writer(jsonp_writer_t *writer, const char *key, size_t size)
 {
-        return jsonp_insert_buffer(buffer, data, 0);
+        char *p = jsonp_begin_value(writer, size * 6 + 4);
+        if (p == NULL)
+                return writer->status;
+        p = jsonp_write_quoted(writer, p, key, size);
+        *p++ = ':';
+        if (writer->indent > 0)
+                *p++ = ' ';
+        writer->after_key = 1;
+        return jsonp_commit_writer(writer, p);
 }
 
-JSONP_EXTERN int jsonp_insert_buffer(buffer_t *buffer, const char *data, int offset)
+JSONP_EXTERN int jsonp_string_writer(jsonp_writer_t *writer, const char *data)
 {
-        if (buffer == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
-                return JSONP_NULL_BUFFER_ERROR;
-        }
+        return jsonp_string_n_writer(writer, data, strlen(data));
+}
 
-        if (buffer->data == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
-                return JSONP_DATA_BUFFER_ERROR;
+JSONP_EXTERN int jsonp_string_n_writer(jsonp_writer_t *writer, const char *data, size_t size)
+{
+        char *p = jsonp_begin_value(writer, size * 6 + 2);
+        if (p == NULL)
+                return writer->status;
+        return jsonp_commit_writer(writer, jsonp_write_quoted(writer, p, data, size));
+}
+
+/* write the digits of @value at @p, two at a time */
+JSONP_STATIC char *jsonp_write_digits(char *p, uint64_t value)
+{
+        static const char pairs[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+        char digits[20], *q = digits + sizeof(digits);
+
+        while (value >= 100) {
+                q -= 2;
+                memcpy(q, pairs + (value % 100) * 2, 2);
+                value /= 100;
+        }
+        if (value >= 10) {
+                q -= 2;
+                memcpy(q, pairs + value * 2, 2);
+        } else {
+                *--q = (char)('0' + value);
         }
 
-        if (data != NULL) {
-                int data_len = strlen(data) + offset;
-                if (data_len >= buffer->capacity) {
-                        int status;
-                        if ((status = jsonp_resize_buffer(buffer))
-                            != JSONP_NO_BUFFER_ERROR)
-                                return status;
+        memcpy(p, q, digits + sizeof(digits) - q);
+        return p + (digits + sizeof(digits) - q);
+}
+
+JSONP_EXTERN int jsonp_int_writer(jsonp_writer_t *writer, int64_t value)
+{
+        char *p = jsonp_begin_value(writer, 20);
+        if (p == NULL)
+                return writer->status;
+        if (value < 0)
+                *p++ = '-';
+        return jsonp_commit_writer(writer, jsonp_write_digits(p, value < 0
+                                                              ? 0 - (uint64_t)value
+                                                              : (uint64_t)value));
+}
+
+JSONP_EXTERN int jsonp_uint_writer(jsonp_writer_t *writer, uint64_t value)
+{
+        char *p = jsonp_begin_value(writer, 20);
+        if (p == NULL)
+                return writer->status;
+        return jsonp_commit_writer(writer, jsonp_write_digits(p, value));
+}
+
+/* the 64 bits of the 192-bit number @r2:@r1:@r0 from bit @shift up */
+JSONP_STATIC uint64_t jsonp_bits192(uint64_t r2, uint64_t r1, uint64_t r0, int shift)
+{
+        if (shift >= 128)
+                return shift > 128 ? r2 >> (shift - 128) : r2;
+        if (shift >= 64)
+                return shift > 64 ? (r1 >> (shift - 64)) | (r2 << (128 - shift)) : r1;
+        return shift > 0 ? (r0 >> shift) | (r1 << (64 - shift)) : r0;
+}
+
+/* round the magnitude of @value to @precision significant digits,
+   giving them as an integer in @digits along with the decimal exponent
+   of the first digit. the value is scaled by an entry of the power of
+   five table, which is within a unit of its last place, so the result
+   is exact unless the discarded part is within a hair of a half, when
+   0 is returned, as it is for values the table doesn't reach */
+JSONP_STATIC int jsonp_round_double(double value, int precision, uint64_t *digits, int *exp10)
+{
+        static const uint64_t powers[] = {
+                1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+                100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+                1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+                1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+        };
+        uint64_t bits, mantissa;
+        int exp2, decimal;
+
+        memcpy(&bits, &value, sizeof(bits));
+        mantissa = bits & 0x000fffffffffffffULL;
+        exp2 = (int)((bits >> 52) & 0x7ff);
+        if (exp2 == 0x7ff || (exp2 == 0 && mantissa == 0) || precision < 1 || precision > 17)
+                return 0;
+        if (exp2 == 0)
+                exp2 = 1;
+        else
+                mantissa |= 1ULL << 52;
+
+        /* the value is @mantissa * 2^@exp2, with the mantissa's top bit
+           at bit 52, and its decimal exponent is @decimal or one more */
+        int lz = jsonp_clz64(mantissa) - 11;
+        mantissa <<= lz;
+        exp2 -= 1075 + lz;
+        decimal = ((exp2 + 52) * 78913) >> 18;
+
+        for (int attempt = 0; attempt < 3; attempt++) {
+                int q = precision - 1 - decimal;
+                if (q < JSONP_POW5_MIN_EXP10 || q > JSONP_POW5_MAX_EXP10)
+                        return 0;
+
+                /* value * 10^q = mantissa * pow5 * 2^-shift */
+                const uint64_t *pow5 = jsonp_pow5_table[q - JSONP_POW5_MIN_EXP10];
+                int shift = 127 - exp2 - ((217706 * q) >> 16);
+                if (shift < 64 || shift > 191)
+                        return 0;
+
+                uint64_t hi_hi, hi_lo = jsonp_mul64(mantissa, pow5[0], &hi_hi);
+                uint64_t lo_hi, lo_lo = jsonp_mul64(mantissa, pow5[1], &lo_hi);
+                uint64_t r1 = hi_lo + lo_hi, r2 = hi_hi + (r1 < hi_lo);
+                uint64_t whole = jsonp_bits192(r2, r1, lo_lo, shift);
+                uint64_t fraction = jsonp_bits192(r2, r1, lo_lo, shift - 64);
+
+                if (whole >= powers[precision]) {
+                        decimal++;
+                        continue;
+                }
+                if (whole < powers[precision - 1]) {
+                        decimal--;
+                        continue;
                 }
 
-                strncpy(buffer->data+offset, data, buffer->capacity);
-                buffer->size = data_len;
-                buffer->data[data_len] = '\0';
+                if (fraction - (1ULL << 63) + 1024 < 2048)
+                        return 0;
+                whole += fraction >> 63;
+                if (whole == powers[precision]) {
+                        whole = powers[precision - 1];
+                        decimal++;
+                }
+                *digits = whole;
+                *exp10 = decimal;
+                return 1;
         }
+        return 0;
+}
 
-        return JSONP_NO_BUFFER_ERROR;
+/* write @digits, which has @precision digits, the first of them with
+   the decimal exponent @exp10, as printf's %g would */
+JSONP_STATIC int jsonp_print_double(char *text, int negative, uint64_t digits, int exp10,
+                                    int precision)
+{
+        char d[20], *p = text;
+        int n = (int)(jsonp_write_digits(d, digits) - d);
+
+        while (n > 1 && d[n - 1] == '0')
+                n--;
+        if (negative)
+                *p++ = '-';
+
+        if (exp10 < -4 || exp10 >= precision) {
+                *p++ = d[0];
+                if (n > 1) {
+                        *p++ = '.';
+                        memcpy(p, d + 1, n - 1);
+                        p += n - 1;
+                }
+                *p++ = 'e';
+                *p++ = exp10 < 0 ? '-' : '+';
+                if (exp10 < 0)
+                        exp10 = -exp10;
+                if (exp10 >= 100)
+                        *p++ = (char)('0' + exp10 / 100);
+                *p++ = (char)('0' + exp10 / 10 % 10);
+                *p++ = (char)('0' + exp10 % 10);
+        } else if (exp10 < 0) {
+                *p++ = '0';
+                *p++ = '.';
+                memset(p, '0', -exp10 - 1);
+                p += -exp10 - 1;
+                memcpy(p, d, n);
+                p += n;
+        } else if (n <= exp10 + 1) {
+                memcpy(p, d, n);
+                memset(p + n, '0', exp10 + 1 - n);
+                p += exp10 + 1;
+        } else {
+                memcpy(p, d, exp10 + 1);
+                p += exp10 + 1;
+                *p++ = '.';
+                memcpy(p, d + exp10 + 1, n - exp10 - 1);
+                p += n - exp10 - 1;
+        }
+        *p = '\0';
+        return (int)(p - text);
 }
 
-JSONP_EXTERN int jsonp_resize_buffer(buffer_t *buffer)
+/* format @value into @text with @precision significant digits, in
+   json's form whatever the locale, returning the length; snprintf is
+   only used when jsonp_round_double can't settle the digits */
+JSONP_STATIC int jsonp_format_double(char *text, size_t size, double value, int precision)
 {
-        if (buffer == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_NULL_BUFFER_ERROR));
-                return JSONP_NULL_BUFFER_ERROR;
+        uint64_t digits;
+        int exp10;
+        if (jsonp_round_double(value, precision, &digits, &exp10))
+                return jsonp_print_double(text, value < 0, digits, exp10, precision);
+
+        const char *point = localeconv()->decimal_point;
+        int length = snprintf(text, size, "%.*g", precision, value);
+        char *at;
+
+        if (strcmp(point, ".") != 0 && (at = strstr(text, point)) != NULL) {
+                size_t point_size = strlen(point);
+                *at = '.';
+                memmove(at + 1, at + point_size, length - (at - text) - point_size + 1);
+                length -= (int)point_size - 1;
         }
+        return length;
+}
 
-        if (buffer->data == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_DATA_BUFFER_ERROR));
-                return JSONP_DATA_BUFFER_ERROR;
+/* the double that @size bytes of json @text read back as */
+JSONP_STATIC double jsonp_read_double(const char *text, int size)
+{
+        jsonp_number_t number;
+        jsonp_decode_number(text, text + size, &number);
+        switch (number.type) {
+        case JSONP_NUMBER_INT:
+                return (double)number.i;
+        case JSONP_NUMBER_UINT:
+                return (double)number.u;
+        default:
+                return number.d;
         }
+}
 
-        char *new_data = (typeof(new_data))realloc(buffer->data, (buffer->capacity*2) + 1);
-        if (new_data == NULL) {
-                jsonp_push_error_debug(jsonp_get_error_buffer(JSONP_RESIZE_BUFFER_ERROR));
-                return JSONP_RESIZE_BUFFER_ERROR;
+/* format @value into @text, which has room for 40 bytes, with the
+   fewest digits that read back as @value, and a fraction when it is
+   whole so that it reads back as a double */
+JSONP_STATIC int jsonp_format_shortest(char *text, double value)
+{
+        /* a double needs at most 17 significant digits to read back,
+           fewer digits are tried first so the shortest is written */
+        int precision = 15;
+        int length = jsonp_format_double(text, 40, value, precision);
+        while (precision < 17 && jsonp_read_double(text, length) != value)
+                length = jsonp_format_double(text, 40, value, ++precision);
+        if (strpbrk(text, ".e") == NULL) {
+                memcpy(text + length, ".0", 3);
+                length += 2;
+        }
+        return length;
+}
+
+JSONP_EXTERN int jsonp_double_writer(jsonp_writer_t *writer, double value)
+{
+        char text[40];
+        int length;
+
+        if (value != value || value - value != 0)
+                return jsonp_null_writer(writer);
+
+        /* whole numbers are written as integers, with a fraction so
+           they read back as doubles */
+        if (value > -9007199254740992.0 && value < 9007199254740992.0 && value == (double)(int64_t)value) {
+                char *p = jsonp_begin_value(writer, 24);
+                if (p == NULL)
+                        return writer->status;
+                if (value < 0 || (value == 0 && 1 / value < 0))
+                        *p++ = '-';
+                int64_t whole = (int64_t)value;
+                p = jsonp_write_digits(p, whole < 0 ? 0 - (uint64_t)whole : (uint64_t)whole);
+                memcpy(p, ".0", 2);
+                return jsonp_commit_writer(writer, p + 2);
         }
 
-        buffer->data = new_data;
-        buffer->capacity *= 2;
-        return JSONP_NO_BUFFER_ERROR;
+        length = jsonp_format_shortest(text, value);
+        return jsonp_write_literal(writer, text, length);
 }
 
-JSONP_EXTERN int jsonp_free_buffer(buffer_t *buffer)
+JSONP_EXTERN int jsonp_bool_writer(jsonp_writer_t *writer, int value)
 {
-        if (buffer != NULL) {
-                if (buffer->data != NULL) {
-                        jsonp_clear_buffer(buffer);
-                        free(buffer->data);
-                        buffer->data = NULL;
-                }
+        return value ? jsonp_write_literal(writer, "true", 4) : jsonp_write_literal(writer, "false", 5);
+}
 
-                buffer->size = 0;
-                buffer->capacity = 0;
+JSONP_EXTERN int jsonp_null_writer(jsonp_writer_t *writer)
+{
+        return jsonp_write_literal(writer, "null", 4);
+}
+
+/* copy @size bytes of @data to the output as they are, a flush's
+   worth at a time so large copies don't grow the buffer; without a
+   flush the buffer grows a piece at a time, until it can't */
+JSONP_STATIC int jsonp_copy_writer(jsonp_writer_t *writer, const char *data, size_t size)
+{
+        while (size > 0 && writer->status == JSONP_NO_ERROR) {
+                size_t n = size > JSONP_WRITER_FLUSH_SIZE ? JSONP_WRITER_FLUSH_SIZE : size;
+                char *p = jsonp_reserve_writer(writer, n);
+                if (p == NULL)
+                        break;
+                memcpy(p, data, n);
+                jsonp_commit_writer(writer, p + n);
+                data += n;
+                size -= n;
         }
-        return JSONP_NO_BUFFER_ERROR;
+        return writer->status;
 }
 
-JSONP_EXTERN JSONP_TYPE jsonp_get_type_token(jsonp_token tok)
+/* reformatting copies the input to the output in spans, only breaking
+   a span where whitespace is dropped or put in, so that input which
+   is already compact is minified with a copy per flush
+             @run is where the input not yet copied starts
+             @margin is the indentation of the writer's own nesting
+*/
+struct jsonp_reformat {
+        jsonp_writer_t *writer;
+        const struct jsonp_scanner *scanner;
+        const char *run;
+        size_t margin;
+        int indent;
+};
+
+/* copy the input up to @p and drop what lies between @p and @q */
+JSONP_STATIC void jsonp_reformat_skip(struct jsonp_reformat *r, const char *p, const char *q)
 {
-        return tok.type;
+        if (p > r->run)
+                jsonp_copy_writer(r->writer, r->run, p - r->run);
+        r->run = q;
 }
 
-JSONP_EXTERN const char *jsonp_get_data_token(jsonp_token tok)
+/* drop the whitespace at @p, returning where it ends */
+JSONP_STATIC const char *jsonp_reformat_space(struct jsonp_reformat *r, const char *p, const char *end)
 {
-        return tok.token.data;
+        if (p < end && jsonp_is_whitespace((unsigned char)*p)) {
+                const char *q = r->scanner->scan_whitespace(p, end);
+                jsonp_reformat_skip(r, p, q);
+                return q;
+        }
+        return p;
 }
 
-JSONP_EXTERN jsonp_token jsonp_peek_token()
+/* put a line break indented for @depth in before @p, when not minifying */
+JSONP_STATIC void jsonp_reformat_break(struct jsonp_reformat *r, const char *p, size_t depth)
 {
-        jsonp_push_token_stack(jsonp_get_token());
-        return tok;
+        if (r->indent > 0) {
+                size_t spaces = r->margin + (size_t)r->indent * depth;
+                char *out;
+                jsonp_reformat_skip(r, p, p);
+                if ((out = jsonp_reserve_writer(r->writer, spaces + 1)) == NULL)
+                        return;
+                *out++ = '\n';
+                memset(out, ' ', spaces);
+                jsonp_commit_writer(r->writer, out + spaces);
+        }
 }
 
-JSONP_EXTERN jsonp_token jsonp_get_token()
+/* step over the body of a string from @p, checking its escapes and
+   utf-8, returning where it ends past the closing quote, or NULL */
+JSONP_STATIC const char *jsonp_reformat_string(const struct jsonp_scanner *scanner,
+                                               const char *p, const char *end)
+{
+        uint32_t code;
+        int size;
+
+        while ((p = scanner->scan_string(p, end)) < end) {
+                unsigned char c = (unsigned char)*p;
+                if (c == '"')
+                        return p + 1;
+                if (c >= 0x80) {
+                        if ((size = jsonp_utf8_length(p, end)) <= 0)
+                                return NULL;
+                        p += size;
+                } else if (c != '\\' || p + 1 >= end) {
+                        return NULL;
+                } else if (p[1] == 'u') {
+                        if (jsonp_parse_unicode_escape(p, end, &code) != JSONP_STRING_OK)
+                                return NULL;
+                        p += 6;
+                } else if (strchr("\"\\/bfnrt", p[1]) != NULL && p[1] != '\0') {
+                        p += 2;
+                } else {
+                        return NULL;
+                }
+        }
+        return NULL;
+}
+
+/* the containers are tracked on a stack of their opening brackets, so
+   nesting depth is only limited by memory */
+JSONP_STATIC int jsonp_reformat_data(const char *data, size_t size, jsonp_writer_t *writer, int indent)
 {
-        if (!jsonp_empty_token_stack())
-                return jsonp_pop_token_stack();
+        struct jsonp_reformat r;
+        const char *p = data, *end = data + size, *q;
+        char *stack = NULL, *out;
+        size_t depth = 0, capacity = 0;
 
-        while (lookahead == ' ' || lookahead == '\t'
-               || lookahead == '\n' || lookahead == '\r')
-                lookahead = next_char();
+        if (writer->status != JSONP_NO_ERROR)
+                return writer->status;
+        r.writer = writer;
+        r.scanner = writer->scanner;
+        r.run = data;
+        r.margin = (size_t)writer->indent * writer->depth;
+        r.indent = indent > 0 ? indent : 0;
 
-        switch (lookahead) {
-        case EOF:
-                return jsonp_eof_token();
+document:
+        p = jsonp_reformat_space(&r, p, end);
+        if (p == end || writer->status != JSONP_NO_ERROR)
+                goto done;
+        /* the separator the writer puts before a value */
+        jsonp_reformat_skip(&r, p, p);
+        if ((out = jsonp_begin_value(writer, 0)) == NULL)
+                goto done;
+        jsonp_commit_writer(writer, out);
+
+value:
+        if (p == end)
+                goto syntax;
+        switch (*p) {
         case '{':
-                return jsonp_open_brace_token();
-        case '}':
-                return jsonp_close_brace_token();
         case '[':
-                return jsonp_open_bracket_token();
-        case ']':
-                return jsonp_close_bracket_token();
-        case ',':
-                return jsonp_comma_token();
-        case ':':
-                return jsonp_colon_token();
+                if (depth == capacity) {
+                        size_t grown = capacity ? capacity * 2 : 64;
+                        char *grew = (char *)realloc(stack, grown);
+                        if (grew == NULL) {
+                                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                                writer->status = JSONP_BUFFER_ERROR;
+                                goto done;
+                        }
+                        stack = grew;
+                        capacity = grown;
+                }
+                stack[depth++] = *p++;
+                q = jsonp_reformat_space(&r, p, end);
+                if (q < end && *q == stack[depth - 1] + 2) {
+                        /* empty, so it stays on one line */
+                        p = q + 1;
+                        depth--;
+                        goto next;
+                }
+                jsonp_reformat_break(&r, q, depth);
+                p = q;
+                if (stack[depth - 1] == '{')
+                        goto key;
+                goto value;
         case '"':
-                return jsonp_string_token();
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-                return jsonp_number_token();
+                if ((q = jsonp_reformat_string(r.scanner, p + 1, end)) == NULL)
+                        goto syntax;
+                p = q;
+                goto next;
+        case 't':
+                if (end - p < 4 || !jsonp_match_literal(p, "true", 4))
+                        goto syntax;
+                p += 4;
+                break;
+        case 'f':
+                if (end - p < 5 || !jsonp_match_literal(p, "false", 5))
+                        goto syntax;
+                p += 5;
+                break;
+        case 'n':
+                if (end - p < 4 || !jsonp_match_literal(p, "null", 4))
+                        goto syntax;
+                p += 4;
+                break;
         default:
-                return jsonp_undefined_token();
+                if (!jsonp_scan_number(p, end, &q))
+                        goto syntax;
+                p = q;
+                break;
+        }
+        /* a number or literal must not run on into what follows */
+        if (p < end && !jsonp_is_delimiter((unsigned char)*p))
+                goto syntax;
+
+next:
+        if (depth == 0)
+                goto document;
+        p = jsonp_reformat_space(&r, p, end);
+        if (p == end)
+                goto syntax;
+        if (*p == ',') {
+                q = jsonp_reformat_space(&r, ++p, end);
+                jsonp_reformat_break(&r, q, depth);
+                p = q;
+                if (stack[depth - 1] == '[')
+                        goto value;
+                goto key;
+        }
+        /* '}' and ']' are two past '{' and '[' */
+        if (*p != stack[depth - 1] + 2)
+                goto syntax;
+        jsonp_reformat_break(&r, p, --depth);
+        p++;
+        goto next;
+
+key:
+        if (p == end || *p != '"' || (q = jsonp_reformat_string(r.scanner, p + 1, end)) == NULL)
+                goto syntax;
+        p = jsonp_reformat_space(&r, q, end);
+        if (p == end || *p != ':')
+                goto syntax;
+        q = jsonp_reformat_space(&r, ++p, end);
+        if (r.indent > 0) {
+                jsonp_reformat_skip(&r, p, q);
+                jsonp_copy_writer(writer, " ", 1);
         }
+        p = q;
+        goto value;
+
+syntax:
+        /* @p is left at the start of whatever was wrong */
+        jsonp_locate_error(jsonp_push_error_debug(JSONP_SYNTAX_ERROR, p == end
+                                                  ? "Unexpected end of json"
+                                                  : "Unexpected character"),
+                           data, size, p - data, 0);
+        writer->status = JSONP_SYNTAX_ERROR;
+done:
+        if (writer->status == JSONP_NO_ERROR)
+                jsonp_reformat_skip(&r, p, p);
+        free(stack);
+        return writer->status;
 }
 
-JSONP_EXTERN jsonp_token jsonp_unget_token(jsonp_token tok)
+JSONP_EXTERN int jsonp_minify(const char *data, size_t size, jsonp_writer_t *writer)
 {
-        jsonp_push_token_stack(tok);
-        return tok;
+        return jsonp_reformat_data(data, size, writer, 0);
 }
 
-JSONP_EXTERN int jsonp_rewind(void)
+JSONP_EXTERN int jsonp_prettify(const char *data, size_t size, jsonp_writer_t *writer, int indent)
 {
-        curr_buffer_ptr = 0;
-        return fseek(curr_fd, 0, SEEK_SET);
+        return jsonp_reformat_data(data, size, writer, indent);
 }
 
-JSONP_EXTERN int jsonp_had_error(void)
+JSONP_EXTERN int jsonp_reformat(jsonp_info_t info, jsonp_writer_t *writer, int indent)
 {
-        return !jsonp_stack_empty_debug();
+        jsonp_lexer_t lexer;
+        int status;
+
+        /* the whole of the data is needed up front, so a file is mapped */
+        if (info.type == JSONP_FILE)
+                info.type = JSONP_MMAP;
+        if ((status = jsonp_lexer_init(&lexer, info)) != JSONP_NO_ERROR)
+                return status;
+        status = jsonp_reformat_data(lexer.input, lexer.input_size, writer, indent);
+        jsonp_lexer_free(&lexer);
+        return status;
 }
 
-JSONP_EXTERN const char *jsonp_get_error(void)
+/* saved documents start with this header, followed by the tape and
+   then the strings, just as they are held in memory */
+#define JSONP_CACHE_VERSION 2
+#define JSONP_CACHE_ORDER 0x01020304u
+
+struct jsonp_cache_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t order;
+        uint64_t tape_size;
+        uint64_t strings_size;
+};
+
+JSONP_STATIC const char jsonp_cache_magic[8] = { 'j', 's', 'o', 'n', 'p', 'd', 'o', 'c' };
+
+JSONP_EXTERN int jsonp_save_document(const jsonp_document_t *doc, const char *path)
+{
+        struct jsonp_cache_header header;
+        memcpy(header.magic, jsonp_cache_magic, sizeof(header.magic));
+        header.version = JSONP_CACHE_VERSION;
+        header.order = JSONP_CACHE_ORDER;
+        header.tape_size = doc->tape_size;
+        header.strings_size = doc->strings_size;
+
+        size_t size = strlen(path);
+        char *temp = (char *)malloc(size + 5);
+        if (temp == NULL) {
+                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                return JSONP_BUFFER_ERROR;
+        }
+        memcpy(temp, path, size);
+        memcpy(temp + size, ".tmp", 5);
+
+        FILE *fd = fopen(temp, "wb");
+        int ok = fd != NULL
+                && fwrite(&header, sizeof(header), 1, fd) == 1
+                && fwrite(doc->tape, sizeof(*doc->tape), doc->tape_size, fd) == doc->tape_size
+                /* a document without strings has none allocated */
+                && (doc->strings_size == 0
+                    || fwrite(doc->strings, 1, doc->strings_size, fd) == doc->strings_size);
+        if (fd != NULL && fclose(fd) != 0)
+                ok = 0;
+        if (ok)
+                ok = rename(temp, path) == 0;
+        else if (fd != NULL)
+                remove(temp);
+        free(temp);
+        if (!ok) {
+                jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                return JSONP_FILE_ERROR;
+        }
+        return JSONP_NO_ERROR;
+}
+
+/* whether @header, of a file of @size bytes, is one this build can use */
+JSONP_STATIC int jsonp_cache_header_ok(const struct jsonp_cache_header *header, size_t size)
+{
+        return memcmp(header->magic, jsonp_cache_magic, sizeof(header->magic)) == 0
+                && header->version == JSONP_CACHE_VERSION
+                && header->order == JSONP_CACHE_ORDER
+                && header->tape_size <= (size - sizeof(*header)) / sizeof(uint64_t)
+                && header->strings_size <= size - sizeof(*header)
+                && sizeof(*header) + header->tape_size * sizeof(uint64_t)
+                   + header->strings_size == size;
+}
+
+JSONP_EXTERN int jsonp_load_document(jsonp_document_t *doc, const char *path)
+{
+        struct jsonp_cache_header header;
+        memset(doc, 0, sizeof(*doc));
+
+#ifdef JSONP_HAVE_MMAP
+        /* the tape and strings are used where they are in the file */
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                return JSONP_FILE_ERROR;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header)) {
+                close(fd);
+                jsonp_push_error_debug(JSONP_FILE_ERROR, "Not a saved document, or saved by another version");
+                return JSONP_FILE_ERROR;
+        }
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+                jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                return JSONP_FILE_ERROR;
+        }
+        memcpy(&header, map, sizeof(header));
+        if (!jsonp_cache_header_ok(&header, (size_t)st.st_size)) {
+                munmap(map, (size_t)st.st_size);
+                jsonp_push_error_debug(JSONP_FILE_ERROR, "Not a saved document, or saved by another version");
+                return JSONP_FILE_ERROR;
+        }
+        doc->map = map;
+        doc->map_size = (size_t)st.st_size;
+        doc->tape = (uint64_t *)((char *)map + sizeof(header));
+        doc->strings = (char *)map + sizeof(header) + header.tape_size * sizeof(*doc->tape);
+#else
+        FILE *fd = fopen(path, "rb");
+        if (fd == NULL) {
+                jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                return JSONP_FILE_ERROR;
+        }
+        long size = fseek(fd, 0, SEEK_END) == 0 ? ftell(fd) : -1;
+        if (size < (long)sizeof(header) || fseek(fd, 0, SEEK_SET) != 0
+            || fread(&header, sizeof(header), 1, fd) != 1
+            || !jsonp_cache_header_ok(&header, (size_t)size)) {
+                fclose(fd);
+                jsonp_push_error_debug(JSONP_FILE_ERROR, "Not a saved document, or saved by another version");
+                return JSONP_FILE_ERROR;
+        }
+
+        /* without mmap they are read into memory of their own */
+        size_t tape_bytes = header.tape_size * sizeof(*doc->tape);
+        doc->tape = (uint64_t *)jsonp_allocate(NULL, tape_bytes ? tape_bytes : 1);
+        doc->strings = (char *)jsonp_allocate(NULL, header.strings_size ? header.strings_size : 1);
+        doc->tape_capacity = header.tape_size ? header.tape_size : 1;
+        doc->strings_capacity = header.strings_size ? header.strings_size : 1;
+        int ok = doc->tape != NULL && doc->strings != NULL
+                && fread(doc->tape, 1, tape_bytes, fd) == tape_bytes
+                && fread(doc->strings, 1, header.strings_size, fd) == header.strings_size;
+        fclose(fd);
+        if (!ok) {
+                jsonp_free_document(doc);
+                jsonp_push_error_debug(JSONP_FILE_ERROR, NULL);
+                return JSONP_FILE_ERROR;
+        }
+#endif
+        doc->tape_size = header.tape_size;
+        doc->strings_size = header.strings_size;
+        return JSONP_NO_ERROR;
+}
+
+/* after a value or a closing entry, owe a comma unless the container
+   it is in ends next; within an object, what follows the comma is a
+   key */
+JSONP_STATIC void jsonp_cache_separate(jsonp_lexer_t *lexer)
+{
+        const jsonp_document_t *doc = &lexer->cache;
+        if (lexer->cache_depth == 0 || lexer->cache_pos >= doc->tape_size)
+                return;
+        int tag = jsonp_tape_tag(doc, lexer->cache_pos);
+        if (tag == '}' || tag == ']')
+                return;
+        lexer->cache_next = JSONP_TYPE_COMMA;
+        lexer->cache_key = jsonp_tape_tag(doc, lexer->cache_stack[lexer->cache_depth - 1]) == '{';
+}
+
+/* the text of a number entry, written out again into @scratch */
+JSONP_STATIC jsonp_token jsonp_cache_number(jsonp_lexer_t *lexer, jsonp_number_t number)
+{
+        char text[40], *end = text;
+        switch (number.type) {
+        case JSONP_NUMBER_INT:
+                if (number.i < 0)
+                        *end++ = '-';
+                end = jsonp_write_digits(end, number.i < 0 ? 0 - (uint64_t)number.i : (uint64_t)number.i);
+                break;
+        case JSONP_NUMBER_UINT:
+                end = jsonp_write_digits(end, number.u);
+                break;
+        default:
+                end += jsonp_format_shortest(text, number.d);
+                break;
+        }
+
+        if (lexer->scratch.data == NULL)
+                jsonp_init_buffer(&lexer->scratch);
+        lexer->scratch.size = 0;
+        jsonp_append_n_buffer(&lexer->scratch, text, (int)(end - text));
+        jsonp_set_token(lexer, JSONP_TYPE_NUMBER, lexer->scratch.data, lexer->scratch.size);
+        lexer->tok.number = number;
+        return lexer->tok;
+}
+
+/* make the next token from the tape of @cache, putting back the commas
+   and colons that a tape leaves out; strings point into the tape's
+   strings, so they aren't copied in JSONP_TOKEN_VIEW mode */
+JSONP_STATIC jsonp_token jsonp_cache_token(jsonp_lexer_t *lexer)
 {
-        return jsonp_pop_error_debug();
+        const jsonp_document_t *doc = &lexer->cache;
+        if (lexer->cache_next != JSONP_TYPE_EMPTY) {
+                int comma = lexer->cache_next == JSONP_TYPE_COMMA;
+                lexer->cache_next = JSONP_TYPE_EMPTY;
+                return comma ? jsonp_set_token(lexer, JSONP_TYPE_COMMA, ",", 1)
+                        : jsonp_set_token(lexer, JSONP_TYPE_COLON, ":", 1);
+        }
+        if (lexer->cache_pos >= doc->tape_size)
+                return jsonp_set_token(lexer, JSONP_TYPE_EOF, "EOF", 3);
+
+        size_t pos = lexer->cache_pos++;
+        jsonp_number_t number;
+        uint64_t bits;
+        jsonp_view_t text;
+
+        switch (jsonp_tape_tag(doc, pos)) {
+        case '{':
+        case '[':
+                if (lexer->cache_depth == lexer->cache_capacity) {
+                        size_t grown = lexer->cache_capacity ? lexer->cache_capacity * 2 : 64;
+                        const jsonp_allocator_t *allocator = lexer->tok.token.allocator;
+                        size_t *stack = lexer->cache_stack
+                                ? (size_t *)jsonp_reallocate(allocator, lexer->cache_stack,
+                                                             lexer->cache_capacity * sizeof(*stack),
+                                                             grown * sizeof(*stack))
+                                : (size_t *)jsonp_allocate(allocator, grown * sizeof(*stack));
+                        if (stack == NULL) {
+                                lexer->cache_pos = pos;
+                                jsonp_push_error_debug(JSONP_BUFFER_ERROR, NULL);
+                                return jsonp_set_token(lexer, JSONP_TYPE_ERROR, "", 0);
+                        }
+                        lexer->cache_stack = stack;
+                        lexer->cache_capacity = grown;
+                }
+                lexer->cache_stack[lexer->cache_depth++] = pos;
+                lexer->cache_key = jsonp_tape_tag(doc, pos) == '{';
+                return jsonp_tape_tag(doc, pos) == '{'
+                        ? jsonp_set_token(lexer, JSONP_TYPE_OPEN_BRACE, "{", 1)
+                        : jsonp_set_token(lexer, JSONP_TYPE_OPEN_BRACKET, "[", 1);
+        case '}':
+        case ']':
+                lexer->cache_depth--;
+                lexer->cache_key = 0;
+                jsonp_cache_separate(lexer);
+                return jsonp_tape_tag(doc, pos) == '}'
+                        ? jsonp_set_token(lexer, JSONP_TYPE_CLOSE_BRACE, "}", 1)
+                        : jsonp_set_token(lexer, JSONP_TYPE_CLOSE_BRACKET, "]", 1);
+        case '"':
+                if (lexer->cache_key) {
+                        lexer->cache_key = 0;
+                        lexer->cache_next = JSONP_TYPE_COLON;
+                } else {
+                        jsonp_cache_separate(lexer);
+                }
+                text = jsonp_tape_string(doc, pos);
+                return jsonp_set_token(lexer, JSONP_TYPE_STRING, text.data, text.size);
+        case 'l':
+        case 'u':
+        case 'd':
+                bits = doc->tape[lexer->cache_pos++];
+                /* filled in as jsonp_decode_number does */
+                number.i = 0;
+                number.u = 0;
+                switch (jsonp_tape_tag(doc, pos)) {
+                case 'l':
+                        number.type = JSONP_NUMBER_INT;
+                        number.i = (int64_t)bits;
+                        number.u = number.i < 0 ? 0 : bits;
+                        number.d = (double)number.i;
+                        break;
+                case 'u':
+                        number.type = JSONP_NUMBER_UINT;
+                        number.u = bits;
+                        number.d = (double)bits;
+                        break;
+                default:
+                        number.type = JSONP_NUMBER_DOUBLE;
+                        memcpy(&number.d, &bits, sizeof(number.d));
+                        break;
+                }
+                jsonp_cache_separate(lexer);
+                return jsonp_cache_number(lexer, number);
+        case 't':
+                jsonp_cache_separate(lexer);
+                return jsonp_set_token(lexer, JSONP_TYPE_TRUE, "true", 4);
+        case 'f':
+                jsonp_cache_separate(lexer);
+                return jsonp_set_token(lexer, JSONP_TYPE_FALSE, "false", 5);
+        default:
+                jsonp_cache_separate(lexer);
+                return jsonp_set_token(lexer, JSONP_TYPE_NULL, "null", 4);
+        }
 }
 
 #endif /* JSONP_IMPLEMENTATION */
@@ -0,0 +1,345 @@
+#ifndef JSONP_HPP_
+#define JSONP_HPP_
+
+/*
+ *  A c++17 layer over jsonp.h, built on the reentrant jsonp_lexer_*
+ *  functions, so each jsonp::lexer is independent of the others and of
+ *  the global lexer. the implementation is still included by writing
+ *      #define JSONP_IMPLEMENTATION
+ *  before including this file, or jsonp.h, in ONE source file.
+ *
+ *  nothing here throws; failures are reported with the same JSONP_ERROR
+ *  codes as the c functions, and recorded on the same per-thread error
+ *  stack.
+*/
+
+#include "jsonp.h"
+
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define JSONP_HAVE_COROUTINES
+#endif
+#endif
+
+namespace jsonp {
+
+/* a token as handed back by a lexer. it owns nothing: @text points into
+   the input, at a static literal, or into a buffer of the lexer's, and
+   like the text of a jsonp_token it is only valid until the next token
+   is read, use jsonp::buffer to keep hold of it */
+class token {
+public:
+        token() noexcept : type_(JSONP_TYPE_EMPTY), number_() {}
+        explicit token(const jsonp_token &tok) noexcept
+                : type_(tok.type), text_(tok.view.data, tok.view.size), number_(tok.number) {}
+
+        JSONP_TYPE type() const noexcept { return type_; }
+        bool is(JSONP_TYPE type) const noexcept { return type_ == type; }
+        std::string_view text() const noexcept { return text_; }
+
+        /* decoded values of JSONP_TYPE_NUMBER tokens */
+        const jsonp_number_t &number() const noexcept { return number_; }
+        bool is_integer() const noexcept { return number_.type != JSONP_NUMBER_DOUBLE; }
+        int64_t as_int() const noexcept { return number_.i; }
+        uint64_t as_uint() const noexcept { return number_.u; }
+        double as_double() const noexcept { return number_.d; }
+
+        /* the token as the c functions take it; it holds no buffer, so
+           it can be handed to a lexer without giving anything away */
+        jsonp_token native() const noexcept
+        {
+                jsonp_token tok = jsonp_token();
+                tok.type = type_;
+                tok.view.data = text_.data();
+                tok.view.size = text_.size();
+                tok.number = number_;
+                return tok;
+        }
+
+private:
+        JSONP_TYPE type_;
+        std::string_view text_;
+        jsonp_number_t number_;
+};
+
+/* an owned copy of some text, such as a token's, released with
+   jsonp_free_buffer when it goes; it can be moved but not copied */
+class buffer {
+public:
+        buffer() noexcept : buffer_() {}
+        explicit buffer(const token &tok) : buffer_() { assign(tok); }
+        buffer(buffer &&other) noexcept : buffer_(other.buffer_) { other.buffer_ = buffer_t(); }
+        buffer &operator=(buffer &&other) noexcept
+        {
+                if (this != &other) {
+                        jsonp_free_buffer(&buffer_);
+                        buffer_ = other.buffer_;
+                        other.buffer_ = buffer_t();
+                }
+                return *this;
+        }
+        buffer(const buffer &) = delete;
+        buffer &operator=(const buffer &) = delete;
+        ~buffer() { jsonp_free_buffer(&buffer_); }
+
+        /* replace the contents with the text of @tok */
+        int assign(const token &tok) { return jsonp_materialize_token(tok.native(), &buffer_); }
+
+        std::string_view view() const noexcept
+        {
+                return std::string_view(buffer_.data, buffer_.data ? buffer_.size : 0);
+        }
+        const char *c_str() const noexcept { return buffer_.data ? buffer_.data : ""; }
+        buffer_t *native() noexcept { return &buffer_; }
+
+private:
+        buffer_t buffer_;
+};
+
+class lexer;
+
+/* marks the end of a lexer's tokens */
+struct token_sentinel {};
+
+/* steps through the tokens of a lexer, reading one each step. the
+   range ends before JSONP_TYPE_EOF, and before JSONP_TYPE_NEED_MORE, so
+   that a stream can be fed and iterated over again; JSONP_TYPE_ERROR and
+   JSONP_TYPE_UNDEFINED tokens are the last ones handed out */
+class token_iterator {
+public:
+        token_iterator() noexcept : lexer_(nullptr) {}
+        explicit token_iterator(jsonp_lexer_t *lexer) : lexer_(lexer) { next(); }
+
+        const token &operator*() const noexcept { return tok_; }
+        const token *operator->() const noexcept { return &tok_; }
+        token_iterator &operator++()
+        {
+                if (tok_.is(JSONP_TYPE_ERROR) || tok_.is(JSONP_TYPE_UNDEFINED))
+                        lexer_ = nullptr;
+                else
+                        next();
+                return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const token_iterator &it, token_sentinel) noexcept
+        {
+                return it.lexer_ == nullptr;
+        }
+        friend bool operator!=(const token_iterator &it, token_sentinel end) noexcept
+        {
+                return !(it == end);
+        }
+
+private:
+        void next()
+        {
+                tok_ = token(jsonp_lexer_get_token(lexer_));
+                if (tok_.is(JSONP_TYPE_EOF) || tok_.is(JSONP_TYPE_NEED_MORE))
+                        lexer_ = nullptr;
+        }
+
+        jsonp_lexer_t *lexer_;
+        token tok_;
+};
+
+/* a lexer over one input, freed with jsonp_lexer_free when it goes.
+   jsonp_lexer_t points into itself, so it is kept on the heap, which
+   leaves the lexer free to be moved; it can't be copied. a lexer that
+   failed to open is empty, status() says why:
+       jsonp::lexer lexer = jsonp::lexer::text(json);
+       if (!lexer)
+               return lexer.status();
+       for (const jsonp::token &tok : lexer)
+               std::cout << tok.text() << '\n';
+*/
+class lexer {
+public:
+        lexer() noexcept : status_(JSONP_NOT_FOUND_ERROR) {}
+        explicit lexer(jsonp_info_t info, jsonp_arena_t *arena = nullptr)
+                : lexer_(new jsonp_lexer_t())
+        {
+                /* a lexer that fails to initialise has already been freed */
+                status_ = jsonp_lexer_init_arena(lexer_.get(), info, arena);
+                if (status_ != JSONP_NO_ERROR)
+                        delete lexer_.release();
+        }
+
+        /* json data, copied, or lexed in place when @borrowed, in which
+           case it must outlive the lexer. a size of 0 has the c layer
+           measure the data with strlen, so empty data is handed over
+           as "" rather than where the view points */
+        static lexer text(std::string_view data, bool borrowed = false)
+        {
+                return lexer(jsonp_create_json_info_n(borrowed ? JSONP_TEXT_BORROWED : JSONP_TEXT,
+                                                      data.empty() ? "" : data.data(), data.size()));
+        }
+        /* a file, read through stdio, or mapped into memory when @mapped */
+        static lexer file(const char *path, bool mapped = false)
+        {
+                return lexer(jsonp_create_json_info(mapped ? JSONP_MMAP : JSONP_FILE, path));
+        }
+        /* a document saved with jsonp_save_document, whose tokens are
+           handed back without lexing */
+        static lexer cache(const char *path)
+        {
+                return lexer(jsonp_create_json_info(JSONP_CACHE, path));
+        }
+        /* json data pushed in pieces with feed */
+        static lexer stream(std::string_view data = std::string_view())
+        {
+                return lexer(jsonp_create_json_info_n(JSONP_STREAM, data.empty() ? nullptr : data.data(),
+                                                      data.size()));
+        }
+
+        lexer(lexer &&) noexcept = default;
+        lexer &operator=(lexer &&) noexcept = default;
+        lexer(const lexer &) = delete;
+        lexer &operator=(const lexer &) = delete;
+
+        int status() const noexcept { return status_; }
+        explicit operator bool() const noexcept { return lexer_ != nullptr; }
+
+        token get() { return token(jsonp_lexer_get_token(lexer_.get())); }
+        token peek() { return token(jsonp_lexer_peek_token(lexer_.get())); }
+        void unget(const token &tok) { jsonp_lexer_unget_token(lexer_.get(), tok.native()); }
+        int rewind() { return jsonp_lexer_rewind(lexer_.get()); }
+        int set_token_mode(JSONP_TOKEN_MODE mode) { return jsonp_lexer_set_token_mode(lexer_.get(), mode); }
+
+        int feed(std::string_view data) { return jsonp_feed(lexer_.get(), data.data(), data.size()); }
+        int finish() { return jsonp_finish(lexer_.get()); }
+
+        int skip_value() { return jsonp_skip_value(lexer_.get()); }
+        int find_field(std::string_view key)
+        {
+                return jsonp_find_field_n(lexer_.get(), key.data(), key.size());
+        }
+        template <typename T>
+        int decode(const jsonp_schema_t &schema, T &out)
+        {
+                return jsonp_decode(lexer_.get(), &schema, &out);
+        }
+
+        token_iterator begin() { return token_iterator(lexer_.get()); }
+        token_sentinel end() const noexcept { return token_sentinel(); }
+
+        /* the lexer, for the c functions that have no wrapper here */
+        jsonp_lexer_t *native() noexcept { return lexer_.get(); }
+
+private:
+        struct deleter {
+                void operator()(jsonp_lexer_t *lexer) const
+                {
+                        jsonp_lexer_free(lexer);
+                        delete lexer;
+                }
+        };
+
+        std::unique_ptr<jsonp_lexer_t, deleter> lexer_;
+        int status_;
+};
+
+/* a document parsed a chunk at a time, as the chunks arrive, which
+   the parser owns, along with its jsonp_parser_t; it can be moved but
+   not copied. feed and finish return what jsonp_parser_feed and
+   jsonp_parser_finish do, JSONP_NEED_MORE_ERROR until the value is
+   complete */
+class parser {
+public:
+        parser() : state_(new state())
+        {
+                /* a parser that fails to initialise has nothing to free */
+                status_ = jsonp_parser_init(&state_->parser, &state_->doc);
+                if (status_ != JSONP_NO_ERROR)
+                        delete state_.release();
+        }
+
+        parser(parser &&) noexcept = default;
+        parser &operator=(parser &&) noexcept = default;
+        parser(const parser &) = delete;
+        parser &operator=(const parser &) = delete;
+
+        int status() const noexcept { return status_; }
+        explicit operator bool() const noexcept { return state_ != nullptr; }
+
+        int feed(std::string_view data)
+        {
+                return jsonp_parser_feed(&state_->parser, data.data(), data.size());
+        }
+        int finish() { return jsonp_parser_finish(&state_->parser); }
+
+        /* the document, which is only whole once finish succeeds */
+        const jsonp_document_t &document() const noexcept { return state_->doc; }
+        jsonp_value_t root() const noexcept { return jsonp_get_root_document(&state_->doc); }
+
+        jsonp_parser_t *native() noexcept { return &state_->parser; }
+
+private:
+        struct state {
+                jsonp_parser_t parser;
+                jsonp_document_t doc;
+        };
+        struct deleter {
+                void operator()(state *state) const
+                {
+                        jsonp_parser_free(&state->parser);
+                        jsonp_free_document(&state->doc);
+                        delete state;
+                }
+        };
+
+        std::unique_ptr<state, deleter> state_;
+        int status_;
+};
+
+#ifdef JSONP_HAVE_COROUTINES
+/* a c++20 coroutine feeding @parser from @read until the input ends.
+   @read is called for each chunk, and returns something that can be
+   co_awaited for a std::string_view, such as a socket read on the
+   caller's event loop; an empty chunk ends the input. the coroutine
+   is of the caller's own @Task type, whose promise takes the
+   JSONP_ERROR it co_returns:
+       int status = co_await jsonp::parse<task<int>>(parser, [&] { return socket.read(); });
+*/
+template <typename Task, typename Read>
+Task parse(parser &parser, Read read)
+{
+        for (;;) {
+                std::string_view chunk = co_await read();
+                if (chunk.empty())
+                        co_return parser.finish();
+                int status = parser.feed(chunk);
+                if (status != JSONP_NO_ERROR && status != JSONP_NEED_MORE_ERROR)
+                        co_return status;
+        }
+}
+#endif
+
+/* holds the global lexer, used by jsonp_get_token and the rest of the
+   non-reentrant functions, open for as long as it lives */
+class global_lexer {
+public:
+        explicit global_lexer(jsonp_info_t info) : status_(jsonp_init(info)) {}
+        global_lexer(const global_lexer &) = delete;
+        global_lexer &operator=(const global_lexer &) = delete;
+        ~global_lexer()
+        {
+                if (status_ == JSONP_NO_ERROR)
+                        jsonp_free();
+        }
+
+        int status() const noexcept { return status_; }
+        explicit operator bool() const noexcept { return status_ == JSONP_NO_ERROR; }
+
+private:
+        int status_;
+};
+
+} /* namespace jsonp */
+
+#endif /* JSONP_HPP_ */